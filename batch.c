@@ -0,0 +1,325 @@
+/*******************************************************************************
+ * File: batch.c
+ * Description: Implements the batch command. Items are read one per line and
+ * 				appended to a growable argv until the next one would push the
+ * 				argument and environment size past ARG_MAX (or -n MAX items
+ * 				are reached), then that invocation is started. Up to -P JOBS
+ * 				invocations run at once; the process running batch_run() is
+ * 				their only parent, so a plain wait() reaps them without
+ * 				touching the shell's other jobs. Exit status follows xargs:
+ * 				0 if every invocation succeeded, 123 if any failed, 125 if one
+ * 				was killed by a signal and 127 if the command was not found.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "output.h"
+#include "envstore.h"
+#include "pathtrie.h"
+#include "batch.h"
+
+// Constants
+#define ARG_HEADROOM 2048 // Left free below ARG_MAX, as xargs does
+#define MAX_ARG_LENGTH (32 * 4096) // Kernel limit for one argument string
+#define MAX_JOBS 256
+
+// Growable NULL terminated argv. Entries from first on are owned items.
+struct ArgList
+{
+	char **argv;
+	int count;
+	int cap;
+	int first; // Index of the first item after the command's own args
+	size_t bytes; // Space the args take when passed to exec
+};
+
+// Globals
+static pid_t RUNNING[MAX_JOBS]; // Invocations not yet reaped
+static int NUM_RUNNING = 0;
+static int FAILURE_STATUS = 0; // Worst exit status seen so far
+
+
+/*******************************************************************************
+ * Function: arg_cost(const char *arg)
+ * Description: Returns the space an argument takes when passed to exec: the
+ * 				string with its terminator and the argv pointer to it.
+*******************************************************************************/
+static size_t arg_cost(const char *arg)
+{
+	return strlen(arg) + 1 + sizeof(char *);
+}
+
+
+/*******************************************************************************
+ * Function: arg_list_push(struct ArgList *list, char *arg)
+ * Description: Appends an argument, growing the array as needed and keeping
+ * 				it NULL terminated.
+*******************************************************************************/
+static void arg_list_push(struct ArgList *list, char *arg)
+{
+	if (list->count + 2 > list->cap)
+	{
+		list->cap = (list->cap == 0) ? 64 : list->cap * 2;
+		list->argv = realloc(list->argv, list->cap * sizeof(char *));
+	}
+	list->argv[list->count++] = arg;
+	list->argv[list->count] = NULL;
+	list->bytes += arg_cost(arg);
+}
+
+
+/*******************************************************************************
+ * Function: arg_list_clear_items(struct ArgList *list)
+ * Description: Frees the items, leaving the command and its own args.
+*******************************************************************************/
+static void arg_list_clear_items(struct ArgList *list)
+{
+	for (int i = list->first; i < list->count; i++)
+	{
+		list->bytes -= arg_cost(list->argv[i]);
+		free(list->argv[i]);
+	}
+	list->count = list->first;
+	list->argv[list->count] = NULL;
+}
+
+
+/*******************************************************************************
+ * Function: exec_size_limit()
+ * Description: Returns how many bytes of args an invocation may use: ARG_MAX
+ * 				less the environment it is exec'd with and some headroom.
+*******************************************************************************/
+static size_t exec_size_limit(void)
+{
+	long argMax = sysconf(_SC_ARG_MAX);
+	if (argMax <= 0)
+		argMax = 128 * 1024;
+
+	size_t envBytes = sizeof(char *);
+	char **envp = env_block();
+	for (int i = 0; envp[i] != NULL; i++)
+		envBytes += arg_cost(envp[i]);
+
+	if ((size_t)argMax < envBytes + ARG_HEADROOM)
+		return 0;
+	return argMax - envBytes - ARG_HEADROOM;
+}
+
+
+/*******************************************************************************
+ * Function: record_status(int childExitMethod)
+ * Description: Folds an invocation's wait status into FAILURE_STATUS, keeping
+ * 				the most serious one.
+*******************************************************************************/
+static void record_status(int childExitMethod)
+{
+	int status = 0;
+	if (WIFSIGNALED(childExitMethod))
+		status = 125;
+	else if (WIFEXITED(childExitMethod) && WEXITSTATUS(childExitMethod) == 127)
+		status = 127;
+	else if (WIFEXITED(childExitMethod) && WEXITSTATUS(childExitMethod) != 0)
+		status = 123;
+
+	if (status > FAILURE_STATUS)
+		FAILURE_STATUS = status;
+}
+
+
+/*******************************************************************************
+ * Function: reap_one()
+ * Description: Waits for one invocation to finish and records its status.
+*******************************************************************************/
+static void reap_one(void)
+{
+	int childExitMethod;
+	pid_t pid = wait(&childExitMethod);
+	if (pid == -1)
+	{
+		NUM_RUNNING = 0;
+		return;
+	}
+
+	for (int i = 0; i < NUM_RUNNING; i++)
+	{
+		if (RUNNING[i] == pid)
+		{
+			RUNNING[i] = RUNNING[--NUM_RUNNING];
+			break;
+		}
+	}
+	record_status(childExitMethod);
+}
+
+
+/*******************************************************************************
+ * Function: forward_signal(int signo)
+ * Description: Signal handler that passes a termination signal on to the
+ * 				running invocations before terminating the same way, so a
+ * 				timeout or shutdown aimed at batch stops its work too.
+*******************************************************************************/
+static void forward_signal(int signo)
+{
+	for (int i = 0; i < NUM_RUNNING; i++)
+		kill(RUNNING[i], signo);
+	signal(signo, SIG_DFL);
+	raise(signo);
+}
+
+
+/*******************************************************************************
+ * Function: start_invocation(struct ArgList *list, const char *path, bool nullInput)
+ * Description: Forks an invocation of the current argv, exec'ing path if the
+ * 				command was found in the PATH trie and using execvp()
+ * 				otherwise. Its stdin is /dev/null when the items come from
+ * 				stdin, so it cannot consume them.
+*******************************************************************************/
+static void start_invocation(struct ArgList *list, const char *path, bool nullInput)
+{
+	out_flush(); // Or the child would have a copy of the queue
+	pid_t pid = fork();
+	switch (pid)
+	{
+		case -1:
+			out_printf("batch: cannot fork: %s\n", strerror(errno));
+			FAILURE_STATUS = 125;
+			break;
+
+		case 0:
+			signal(SIGTERM, SIG_DFL);
+			signal(SIGHUP, SIG_DFL);
+			if (nullInput)
+			{
+				int devNull = open("/dev/null", O_RDONLY);
+				if (devNull != -1)
+					dup2(devNull, STDIN_FILENO);
+			}
+			if (path != NULL)
+				execv(path, list->argv);
+			execvp(list->argv[0], list->argv);
+			out_printf("%s: command not found\n", list->argv[0]);
+			out_flush();
+			_exit(127);
+
+		default:
+			RUNNING[NUM_RUNNING++] = pid;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: run_items(struct ArgList *list, const char *path, bool nullInput, int maxJobs)
+ * Description: Starts an invocation with the collected items once fewer than
+ * 				maxJobs are running, then clears the items for the next one.
+*******************************************************************************/
+static void run_items(struct ArgList *list, const char *path, bool nullInput, int maxJobs)
+{
+	while (NUM_RUNNING >= maxJobs)
+		reap_one();
+	start_invocation(list, path, nullInput);
+	arg_list_clear_items(list);
+}
+
+
+/*******************************************************************************
+ * Function: batch_run(char *arguments[], bool usePathTrie)
+ * Description: Takes in the batch command's args and whether the command may
+ * 				be looked up in the PATH trie (not when the command has its own
+ * 				PATH). Runs the command over every item and returns the exit
+ * 				status for batch. Called in a forked child with redirection and
+ * 				the command's environment already set up.
+*******************************************************************************/
+int batch_run(char *arguments[], bool usePathTrie)
+{
+	int maxJobs = 1;
+	int maxItems = 0; // 0 for no limit other than size
+	char *fileName = NULL;
+
+	int pos = 1;
+	while (arguments[pos] != NULL && arguments[pos][0] == '-' && arguments[pos+1] != NULL)
+	{
+		if (strcmp(arguments[pos], "-P") == 0)
+			maxJobs = atoi(arguments[pos+1]);
+		else if (strcmp(arguments[pos], "-n") == 0)
+			maxItems = atoi(arguments[pos+1]);
+		else if (strcmp(arguments[pos], "-f") == 0)
+			fileName = arguments[pos+1];
+		else
+			break;
+		pos += 2;
+	}
+
+	if (arguments[pos] == NULL || arguments[pos][0] == '-' || maxJobs < 1 || maxItems < 0)
+	{
+		out_printf("usage: batch [-P JOBS] [-n MAX] [-f FILE] command [args...]\n");
+		return 1;
+	}
+	if (maxJobs > MAX_JOBS)
+		maxJobs = MAX_JOBS;
+
+	// A new stream, since stdin's buffer may hold input read by the shell
+	FILE *input = (fileName != NULL) ? fopen(fileName, "r") : fdopen(STDIN_FILENO, "r");
+	if (input == NULL)
+	{
+		out_printf("batch: cannot open %s\n", fileName != NULL ? fileName : "stdin");
+		return 1;
+	}
+
+	// The command and its own args start every invocation
+	struct ArgList list = {0};
+	for (; arguments[pos] != NULL; pos++)
+		arg_list_push(&list, arguments[pos]);
+	list.first = list.count;
+
+	size_t limit = exec_size_limit();
+	const char *path = usePathTrie ? path_trie_lookup(list.argv[0]) : NULL;
+	signal(SIGTERM, forward_signal);
+	signal(SIGHUP, forward_signal);
+
+	char *line = NULL;
+	size_t lineSize = 0;
+	ssize_t len;
+	while ((len = getline(&line, &lineSize, input)) != -1)
+	{
+		if (len > 0 && line[len-1] == '\n')
+			line[--len] = '\0';
+		if (len == 0)
+			continue;
+
+		// Start what has been collected if this item does not fit with it
+		if (list.bytes + arg_cost(line) > limit && list.count > list.first)
+			run_items(&list, path, fileName == NULL, maxJobs);
+
+		if (len >= MAX_ARG_LENGTH || list.bytes + arg_cost(line) > limit)
+		{
+			out_printf("batch: item too long: %.40s...\n", line);
+			if (FAILURE_STATUS < 123)
+				FAILURE_STATUS = 123;
+			continue;
+		}
+
+		arg_list_push(&list, strdup(line));
+		if (maxItems > 0 && list.count - list.first == maxItems)
+			run_items(&list, path, fileName == NULL, maxJobs);
+	}
+
+	// Whatever is left over
+	if (list.count > list.first)
+		run_items(&list, path, fileName == NULL, maxJobs);
+
+	while (NUM_RUNNING > 0)
+		reap_one();
+
+	free(line);
+	free(list.argv);
+	fclose(input);
+	return FAILURE_STATUS;
+}
@@ -0,0 +1,18 @@
+/*******************************************************************************
+ * File: batch.h
+ * Description: The batch command, an xargs-style runner:
+ * 					batch [-P JOBS] [-n MAX] [-f FILE] command [args...]
+ * 				reads one item per line from FILE or stdin and runs command
+ * 				with as many items appended as fit under ARG_MAX, running up
+ * 				to JOBS invocations at a time. It runs in the forked child in
+ * 				place of exec, which supervises the invocations, so it works
+ * 				with &, redirection and the job prefixes like any command.
+*******************************************************************************/
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED 1
+
+#include <stdbool.h>
+
+int batch_run(char *arguments[], bool usePathTrie);
+
+#endif
@@ -0,0 +1,48 @@
+#!/bin/bash
+# Name: copy_bench.sh
+# Description: Compares the cat builtin (copy_file_range and friends, no fork)
+#              with /bin/cat run by smallsh, copying files of each size with
+#              "cat FILE > OUT". Small files are copied many times so the
+#              fork+exec cost shows; large ones measure throughput. The files
+#              are written to DIR, which needs room for two of the largest.
+# Usage: bench/copy_bench.sh [sizes] [dir] [path to smallsh]
+#        sizes defaults to "4K 64K 1M 16M 256M 1G 10G"
+
+SIZES=${1:-"4K 64K 1M 16M 256M 1G 10G"}
+DIR=${2:-/tmp}
+SMALLSH=${3:-./smallsh}
+SOURCE="$DIR/copy_bench.in"
+TARGET="$DIR/copy_bench.out"
+
+# Times REPS copies done by the given cat command, in nanoseconds
+run()
+{
+	local command=$1 reps=$2
+	local script
+	script=$(for ((i = 0; i < reps; i++)); do echo "$command $SOURCE > $TARGET"; done; echo exit)
+	local start end
+	sync # Start each run without the last one's dirty pages
+	start=$(date +%s%N)
+	echo "$script" | "$SMALLSH" > /dev/null
+	end=$(date +%s%N)
+	echo $((end - start))
+}
+
+printf "%-6s %6s %14s %14s %10s %10s\n" size reps "builtin us/op" "/bin/cat us/op" "builtin MB/s" "cat MB/s"
+for size in $SIZES; do
+	bytes=$(numfmt --from=iec "$size")
+	head -c "$bytes" /dev/urandom > "$SOURCE" 2>/dev/null ||
+		{ echo "cannot create $size file in $DIR"; break; }
+
+	# About 256 MiB copied per run, between 1 and 1000 copies
+	reps=$(( 268435456 / bytes ))
+	(( reps < 1 )) && reps=1
+	(( reps > 1000 )) && reps=1000
+
+	builtin=$(run cat "$reps")
+	external=$(run /bin/cat "$reps")
+	printf "%-6s %6d %14d %14d %10d %10d\n" "$size" "$reps" \
+		$((builtin / reps / 1000)) $((external / reps / 1000)) \
+		$((bytes * reps * 1000 / builtin)) $((bytes * reps * 1000 / external))
+done
+rm -f "$SOURCE" "$TARGET"
@@ -0,0 +1,74 @@
+/*******************************************************************************
+ * File: history_bench.c
+ * Description: Benchmark for the history index. Builds a history log with the
+ * 				requested number of generated commands (1,000,000 by default),
+ * 				then times substring searches and !prefix lookups against it.
+ * Usage: history_bench [entries] [logfile]
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include "../history.h"
+
+// Constants
+#define NUM_QUERIES 10
+
+static const char *VERBS[] = {"git", "make", "ls", "cat", "grep", "ssh", "docker", "kubectl"};
+static const char *ARGS[] = {"status", "-la", "build", "logs", "--follow", "deploy", "main", "test"};
+
+
+/*******************************************************************************
+ * Function: now_us()
+ * Description: Returns a monotonic timestamp in microseconds.
+*******************************************************************************/
+static double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int entries = (argc > 1) ? atoi(argv[1]) : 1000000;
+	const char *path = (argc > 2) ? argv[2] : "/tmp/smallsh_history_bench";
+
+	// Generate the log
+	unlink(path);
+	FILE *log = fopen(path, "w");
+	for (int i = 0; i < entries; i++)
+	{
+		fprintf(log, "%s %s %s-%d /srv/app/%d.log\n", VERBS[i % 8], ARGS[(i / 8) % 8],
+			ARGS[(i / 64) % 8], i, i % 977);
+	}
+	fclose(log);
+
+	double start = now_us();
+	history_init(path);
+	printf("loaded %d entries in %.1f ms\n", history_size(), (now_us() - start) / 1000);
+
+	const char *queries[NUM_QUERIES] = {"status", "deploy-12", "-999999", "main-500000 ",
+		"/srv/app/976.log", "no such command", "kubectl logs", "zz", "g-", "Q"};
+	for (int i = 0; i < NUM_QUERIES; i++)
+	{
+		start = now_us();
+		int id = history_search(queries[i], history_size());
+		printf("search %-20s -> %8d  %8.1f us\n", queries[i], id, now_us() - start);
+	}
+
+	const char *prefixes[NUM_QUERIES] = {"git", "docker logs", "cat main build-99",
+		"ssh --follow", "make status deploy-1", "nope", "g", "kubectl test", "zz", "ls"};
+	for (int i = 0; i < NUM_QUERIES; i++)
+	{
+		start = now_us();
+		int id = history_find_prefix(prefixes[i]);
+		printf("prefix %-20s -> %8d  %8.1f us\n", prefixes[i], id, now_us() - start);
+	}
+
+	unlink(path);
+	return 0;
+}
@@ -0,0 +1,44 @@
+#!/bin/bash
+# Name: output_syscalls.sh
+# Description: Counts the write syscalls smallsh makes for its own messages in
+#              a batch run with many short background jobs, with the output
+#              queue on (default) and off (SMALLSH_UNBATCHED_OUTPUT=1).
+#              Uses strace -c when it is installed; otherwise reads syscw from
+#              the shell's /proc/<pid>/io at the end of the run.
+# Usage: bench/output_syscalls.sh [jobs] [path to smallsh]
+
+JOBS=${1:-1000}
+SMALLSH=${2:-./smallsh}
+SCRIPT=$(mktemp)
+
+# Background jobs that finish quickly, so each prompt reports completions
+for i in $(seq "$JOBS"); do
+	echo "true &"
+	if (( i % 10 == 0 )); then
+		echo "sleep 0.01"
+		echo "status"
+	fi
+done > "$SCRIPT"
+
+run()
+{
+	local label=$1
+	shift
+	if command -v strace > /dev/null; then
+		# -f is left off so only the shell's own writes are counted
+		local counts
+		counts=$( { echo exit; } | cat "$SCRIPT" - | env "$@" strace -c -e trace=write,writev \
+			"$SMALLSH" 2>&1 >/dev/null | awk '$NF == "write" || $NF == "writev" {print $NF "=" $4}')
+		printf "%-10s %s\n" "$label" "$(echo $counts)"
+	else
+		local io
+		io=$( { cat "$SCRIPT"; echo 'cat /proc/$$/io'; echo exit; } | env "$@" "$SMALLSH" |
+			awk '/syscw/ {print $2}')
+		printf "%-10s write+writev=%s (from /proc/<pid>/io)\n" "$label" "$io"
+	fi
+}
+
+echo "$JOBS background jobs"
+run batched
+run unbatched SMALLSH_UNBATCHED_OUTPUT=1
+rm -f "$SCRIPT"
@@ -0,0 +1,56 @@
+#!/bin/bash
+# Name: redirect_bench.sh
+# Description: Compares the plain syscalls (default) with the io_uring engine
+#              (SMALLSH_IO_URING=1) on a redirect-heavy script: each line is
+#              a cat builtin that reads several small files, or one through
+#              <, into a file given with >. Reports the time per line and,
+#              when strace is installed, the syscalls the shell made for
+#              opening and closing files (openat, close, io_uring_enter).
+# Usage: bench/redirect_bench.sh [lines] [files per line] [path to smallsh]
+
+LINES=${1:-5000}
+FILES=${2:-4}
+SMALLSH=${3:-./smallsh}
+DIR=$(mktemp -d)
+SCRIPT="$DIR/script"
+
+for ((i = 0; i < FILES; i++)); do
+	echo "line $i" > "$DIR/in$i"
+done
+INPUTS=$(for ((i = 0; i < FILES; i++)); do printf "%s " "$DIR/in$i"; done)
+for ((i = 0; i < LINES; i++)); do
+	if (( i % 2 == 0 )); then
+		echo "cat $INPUTS> $DIR/out"
+	else
+		echo "cat < $DIR/in0 > $DIR/out"
+	fi
+done > "$SCRIPT"
+echo exit >> "$SCRIPT"
+
+run()
+{
+	local label=$1
+	shift
+	local start end
+	start=$(date +%s%N)
+	env "$@" "$SMALLSH" < "$SCRIPT" > /dev/null
+	end=$(date +%s%N)
+	local usPerLine=$(( (end - start) / LINES / 1000 ))
+
+	local counts=""
+	if command -v strace > /dev/null; then
+		# -f is left off so only the shell's own calls are counted
+		counts=$(env "$@" strace -c -e trace=openat,open,close,io_uring_enter \
+			"$SMALLSH" < "$SCRIPT" 2>&1 >/dev/null |
+			awk '$NF ~ /^(openat|open|close|io_uring_enter)$/ {total += $4; printf "%s=%s ", $NF, $4}
+				END {printf "total=%d", total}')
+	else
+		counts="(install strace for syscall counts)"
+	fi
+	printf "%-10s %6d us/line  %s\n" "$label" "$usPerLine" "$counts"
+}
+
+echo "$LINES lines, $FILES files per cat"
+run plain
+run io_uring SMALLSH_IO_URING=1
+rm -rf "$DIR"
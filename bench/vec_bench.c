@@ -0,0 +1,157 @@
+/*******************************************************************************
+ * File: vec_bench.c
+ * Description: Microbenchmark for the vectors in vec.h against DynArr. Times
+ * 				appending and reading ints, a job list where jobs finish in
+ * 				random order and are removed by pid, and building a command's
+ * 				args with and without a small buffer.
+ * Usage: vec_bench [count]
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../dynArray.h"
+#include "../vec.h"
+
+// Constants
+#define NUM_JOBS 4096
+#define NUM_LINES 200000
+#define ARGS_PER_LINE 6
+
+VEC_DECLARE(ArgHeapVec, arg_heap_vec, char *)
+
+static char *WORDS[ARGS_PER_LINE] = {"grep", "-rn", "TODO", "src", ">", "out"};
+
+
+/*******************************************************************************
+ * Function: now_us()
+ * Description: Returns a monotonic timestamp in microseconds.
+*******************************************************************************/
+static double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+/*******************************************************************************
+ * Function: report(const char *what, double dynArrUs, double vecUs)
+ * Description: Prints one comparison.
+*******************************************************************************/
+static void report(const char *what, double dynArrUs, double vecUs)
+{
+	printf("%-28s DynArr %10.1f us   vec %10.1f us   %5.2fx\n", what, dynArrUs, vecUs,
+		dynArrUs / vecUs);
+}
+
+
+/*******************************************************************************
+ * Function: shuffled(int count)
+ * Description: Returns a malloc'd random permutation of 0..count-1, the same
+ * 				for every run.
+*******************************************************************************/
+static int *shuffled(int count)
+{
+	int *order = malloc(count * sizeof(int));
+	for (int i = 0; i < count; i++)
+		order[i] = i;
+	srand(1);
+	for (int i = count - 1; i > 0; i--)
+	{
+		int j = rand() % (i + 1);
+		int swap = order[i];
+		order[i] = order[j];
+		order[j] = swap;
+	}
+	return order;
+}
+
+
+int main(int argc, char *argv[])
+{
+	int count = (argc > 1) ? atoi(argv[1]) : 10000000;
+	volatile long sink = 0;
+
+	// Append and read back
+	double start = now_us();
+	DynArr *dynArr = newDynArr(4);
+	for (int i = 0; i < count; i++)
+		addDynArr(dynArr, i);
+	for (int i = 0; i < count; i++)
+		sink += getDynArr(dynArr, i);
+	deleteDynArr(dynArr);
+	double dynArrUs = now_us() - start;
+
+	start = now_us();
+	PidVec vec;
+	pid_vec_init(&vec);
+	for (int i = 0; i < count; i++)
+		pid_vec_push(&vec, i);
+	for (int i = 0; i < vec.size; i++)
+		sink += vec.items[i];
+	pid_vec_free(&vec);
+	report("append + read", dynArrUs, now_us() - start);
+
+	// Jobs finishing in random order, removed by pid
+	int *order = shuffled(NUM_JOBS);
+	start = now_us();
+	dynArr = newDynArr(4);
+	for (int i = 0; i < NUM_JOBS; i++)
+		addDynArr(dynArr, i);
+	for (int i = 0; i < NUM_JOBS; i++)
+		removeDynArr(dynArr, order[i]);
+	deleteDynArr(dynArr);
+	dynArrUs = now_us() - start;
+
+	start = now_us();
+	pid_vec_init(&vec);
+	for (int i = 0; i < NUM_JOBS; i++)
+		pid_vec_push(&vec, i);
+	for (int i = 0; i < NUM_JOBS; i++)
+	{
+		for (int j = 0; j < vec.size; j++)
+		{
+			if (vec.items[j] == order[i])
+			{
+				pid_vec_swap_remove(&vec, j);
+				break;
+			}
+		}
+	}
+	pid_vec_free(&vec);
+	report("remove jobs by pid", dynArrUs, now_us() - start);
+	free(order);
+
+	// Args for a line, which a small vector holds without allocating
+	start = now_us();
+	for (int line = 0; line < NUM_LINES; line++)
+	{
+		ArgHeapVec args;
+		arg_heap_vec_init(&args);
+		for (int i = 0; i < ARGS_PER_LINE; i++)
+			arg_heap_vec_push(&args, WORDS[i]);
+		arg_heap_vec_push(&args, NULL);
+		sink += args.size;
+		arg_heap_vec_free(&args);
+	}
+	double heapUs = now_us() - start;
+
+	start = now_us();
+	for (int line = 0; line < NUM_LINES; line++)
+	{
+		ArgVec args;
+		arg_vec_init(&args);
+		for (int i = 0; i < ARGS_PER_LINE; i++)
+			arg_vec_push(&args, WORDS[i]);
+		arg_vec_push(&args, NULL);
+		sink += args.size;
+		arg_vec_free(&args);
+	}
+	double smallUs = now_us() - start;
+	printf("%-28s heap   %10.1f us   small %8.1f us   %5.2fx\n", "args for a line", heapUs,
+		smallUs, heapUs / smallUs);
+
+	return 0;
+}
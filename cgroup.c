@@ -0,0 +1,431 @@
+/*******************************************************************************
+ * File: cgroup.c
+ * Description: Implements the job cgroups described in cgroup.h. The shell
+ * 				makes the cgroup and writes its limits before the fork, the
+ * 				child moves itself in before exec, so nothing the command
+ * 				starts escapes the limits, and the shell also moves the child
+ * 				in to find out whether that worked. A cgroup that still holds
+ * 				processes the job left running when it is reaped is removed
+ * 				once they have gone, or killed at exit.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include "output.h"
+#include "envstore.h"
+#include "journal.h"
+#include "vec.h"
+#include "cgroup.h"
+
+// Constants
+#define CPU_PERIOD_US 100000
+#define MIN_QUOTA_US 1000 // The kernel refuses less
+#define PATH_LEN 4096
+#define FILE_SIZE 4096
+#define REMOVE_TRIES 20 // At exit, 5 ms apart
+
+// A job's cgroup, with pid 0 once the job is reaped but the cgroup is not empty
+struct CgroupJob
+{
+	pid_t pid;
+	char *path;
+};
+
+VEC_DECLARE(CgroupVec, cgroup_vec, struct CgroupJob)
+
+// Globals
+static CgroupVec JOBS = {NULL, 0, 0};
+static unsigned NEXT_ID = 0;
+static char LAST_REASON[PATH_LEN + 128] = ""; // Why cgroups were unavailable
+static bool WARNED_CONTROLLER[3] = {false, false, false};
+
+
+/*******************************************************************************
+ * Function: warn_unavailable(const char *format, ...)
+ * Description: Displays why limits cannot be used, unless that was also the
+ * 				reason last time.
+*******************************************************************************/
+static void warn_unavailable(const char *format, ...)
+{
+	char reason[sizeof(LAST_REASON)];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(reason, sizeof(reason), format, args);
+	va_end(args);
+	if (strcmp(reason, LAST_REASON) == 0)
+		return;
+	strcpy(LAST_REASON, reason);
+	out_printf("limit: %s; running without limits\n", reason);
+}
+
+
+/*******************************************************************************
+ * Function: parse_memory_size(const char *text, long long *bytes)
+ * Description: Parses a byte count with an optional K, M, G or T suffix.
+ * 				Returns false if it is not a positive size.
+*******************************************************************************/
+bool parse_memory_size(const char *text, long long *bytes)
+{
+	char *end;
+	errno = 0;
+	long long value = strtoll(text, &end, 10);
+	if (end == text || value <= 0 || errno != 0)
+		return false;
+
+	const char *units = "KMGT";
+	if (*end != '\0')
+	{
+		const char *unit = strchr(units, toupper((unsigned char)*end));
+		if (unit == NULL || end[1] != '\0')
+			return false;
+		for (int shift = unit - units + 1; shift > 0; shift--)
+		{
+			if (value > (1LL << 52))
+				return false;
+			value *= 1024;
+		}
+	}
+	*bytes = value;
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: parse_cpu_quota(const char *text, long long *quotaUs)
+ * Description: Parses a number of CPUs such as 0.5 or 2 into the quota for
+ * 				each CPU_PERIOD_US. Returns false if it is not a positive
+ * 				number.
+*******************************************************************************/
+bool parse_cpu_quota(const char *text, long long *quotaUs)
+{
+	char *end;
+	double cpus = strtod(text, &end);
+	if (end == text || *end != '\0' || !(cpus > 0) || cpus > 1e6)
+		return false;
+	*quotaUs = (long long)(cpus * CPU_PERIOD_US + 0.5);
+	if (*quotaUs < MIN_QUOTA_US)
+		*quotaUs = MIN_QUOTA_US;
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: write_file(int dirFd, const char *name, const char *format, ...)
+ * Description: Writes a value to one of a cgroup's files. Returns false with
+ * 				errno set if it could not be written.
+*******************************************************************************/
+static bool write_file(int dirFd, const char *name, const char *format, ...)
+{
+	char value[64];
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(value, sizeof(value), format, args);
+	va_end(args);
+
+	int fd = openat(dirFd, name, O_WRONLY | O_CLOEXEC);
+	if (fd == -1)
+		return false;
+	bool ok = write(fd, value, len) == len;
+	int savedErrno = errno;
+	close(fd);
+	errno = savedErrno;
+	return ok;
+}
+
+
+/*******************************************************************************
+ * Function: read_file(const char *dir, const char *name, char *buffer)
+ * Description: Reads one of a cgroup's files into a FILE_SIZE buffer. Returns
+ * 				false if it does not exist.
+*******************************************************************************/
+static bool read_file(const char *dir, const char *name, char *buffer)
+{
+	char path[PATH_LEN];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return false;
+	ssize_t len = read(fd, buffer, FILE_SIZE - 1);
+	close(fd);
+	buffer[(len > 0) ? len : 0] = '\0';
+	return len > 0;
+}
+
+
+/*******************************************************************************
+ * Function: find_value(const char *text, const char *key)
+ * Description: Returns the value on the "key value" line of a flat keyed
+ * 				file such as cpu.stat, or -1 if it has no such line.
+*******************************************************************************/
+static long long find_value(const char *text, const char *key)
+{
+	size_t keyLen = strlen(key);
+	for (const char *line = text; line != NULL && *line != '\0'; )
+	{
+		if (strncmp(line, key, keyLen) == 0 && line[keyLen] == ' ')
+			return atoll(line + keyLen + 1);
+		line = strchr(line, '\n');
+		if (line != NULL)
+			line++;
+	}
+	return -1;
+}
+
+
+/*******************************************************************************
+ * Function: enable_controller(const char *parent, const char *name)
+ * Description: Makes a controller available to the cgroups under parent if it
+ * 				is not already. Failures show up when the limit is written.
+*******************************************************************************/
+static void enable_controller(const char *parent, const char *name)
+{
+	char text[FILE_SIZE];
+	if (read_file(parent, "cgroup.subtree_control", text))
+	{
+		for (char *word = strtok(text, " \n"); word != NULL; word = strtok(NULL, " \n"))
+		{
+			if (strcmp(word, name) == 0)
+				return;
+		}
+	}
+
+	int parentFd = open(parent, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (parentFd != -1)
+	{
+		write_file(parentFd, "cgroup.subtree_control", "+%s", name);
+		close(parentFd);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: set_limit(int dirFd, const char *parent, int controller,
+ * 				const char *file, const char *value)
+ * Description: Writes one limit, warning once per controller if it cannot.
+*******************************************************************************/
+static void set_limit(int dirFd, const char *parent, int controller, const char *file,
+	const char *value)
+{
+	static const char *NAMES[3] = {"memory", "cpu", "pids"};
+	if (write_file(dirFd, file, "%s", value) || WARNED_CONTROLLER[controller])
+		return;
+	WARNED_CONTROLLER[controller] = true;
+	out_printf("limit: cannot set %s (%s controller under %s: %s); running without it\n",
+		file, NAMES[controller], parent, strerror(errno));
+}
+
+
+/*******************************************************************************
+ * Function: cgroup_prepare(const struct CgroupLimits *limits, char **path)
+ * Description: Takes in a job's limits. Makes a new cgroup for it under
+ * 				SMALLSH_CGROUP and writes the limits, warning about any that
+ * 				cannot be set. Returns an fd for the cgroup, close on exec, and
+ * 				sets path to its malloc'd path, or returns -1 after warning if
+ * 				the job cannot have one.
+*******************************************************************************/
+int cgroup_prepare(const struct CgroupLimits *limits, char **path)
+{
+	*path = NULL;
+	const char *parent = env_get("SMALLSH_CGROUP");
+	struct statfs info;
+	if (parent == NULL || parent[0] == '\0')
+	{
+		warn_unavailable("SMALLSH_CGROUP is not set");
+		return -1;
+	}
+	if (statfs(parent, &info) == -1 || info.f_type != CGROUP2_SUPER_MAGIC)
+	{
+		warn_unavailable("%s is not a cgroup v2 directory", parent);
+		return -1;
+	}
+
+	// memory is wanted for memory.peak even without a limit
+	enable_controller(parent, "memory");
+	if (limits->cpuQuotaUs > 0)
+		enable_controller(parent, "cpu");
+	if (limits->pidsMax > 0)
+		enable_controller(parent, "pids");
+
+	char name[PATH_LEN];
+	snprintf(name, sizeof(name), "%s/smallsh-%d-%u", parent, getpid(), NEXT_ID++);
+	if (mkdir(name, 0755) == -1)
+	{
+		warn_unavailable("cannot create a cgroup in %s: %s", parent, strerror(errno));
+		return -1;
+	}
+	int dirFd = open(name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirFd == -1)
+	{
+		warn_unavailable("cannot open %s: %s", name, strerror(errno));
+		rmdir(name);
+		return -1;
+	}
+
+	char value[64];
+	if (limits->memoryMax > 0)
+	{
+		snprintf(value, sizeof(value), "%lld", limits->memoryMax);
+		set_limit(dirFd, parent, 0, "memory.max", value);
+	}
+	if (limits->cpuQuotaUs > 0)
+	{
+		snprintf(value, sizeof(value), "%lld %d", limits->cpuQuotaUs, CPU_PERIOD_US);
+		set_limit(dirFd, parent, 1, "cpu.max", value);
+	}
+	if (limits->pidsMax > 0)
+	{
+		snprintf(value, sizeof(value), "%lld", limits->pidsMax);
+		set_limit(dirFd, parent, 2, "pids.max", value);
+	}
+
+	*path = strdup(name);
+	return dirFd;
+}
+
+
+/*******************************************************************************
+ * Function: cgroup_join(int cgroupFd)
+ * Description: Moves the calling child into the cgroup from cgroup_prepare(),
+ * 				before it execs. If it cannot, it runs without the limits; the
+ * 				shell reports that from cgroup_track().
+*******************************************************************************/
+void cgroup_join(int cgroupFd)
+{
+	write_file(cgroupFd, "cgroup.procs", "0");
+}
+
+
+/*******************************************************************************
+ * Function: cgroup_track(pid_t pid, int cgroupFd, char *path)
+ * Description: Takes in a spawned child and its cgroup from cgroup_prepare(),
+ * 				whose path it takes over. Moves the child in, which it has
+ * 				normally done itself, and remembers the cgroup until the child
+ * 				is reaped. Warns and removes the cgroup if the child cannot be
+ * 				placed in it.
+*******************************************************************************/
+void cgroup_track(pid_t pid, int cgroupFd, char *path)
+{
+	// ESRCH is a child that has already joined and exited
+	if (!write_file(cgroupFd, "cgroup.procs", "%lld", (long long)pid) && errno != ESRCH)
+	{
+		warn_unavailable("cannot move jobs into %s: %s", path, strerror(errno));
+		close(cgroupFd);
+		rmdir(path);
+		free(path);
+		return;
+	}
+	close(cgroupFd);
+
+	struct CgroupJob job = {pid, path};
+	cgroup_vec_push(&JOBS, job);
+}
+
+
+/*******************************************************************************
+ * Function: remove_job(int index)
+ * Description: Removes a job's cgroup if it is empty and forgets it. Returns
+ * 				false if processes are still in it.
+*******************************************************************************/
+static bool remove_job(int index)
+{
+	if (rmdir(JOBS.items[index].path) == -1 && errno == EBUSY)
+		return false;
+	free(JOBS.items[index].path);
+	cgroup_vec_swap_remove(&JOBS, index);
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: cgroup_reaped(pid_t pid)
+ * Description: Takes in a reaped child. If it had a cgroup, reads what its
+ * 				whole process tree used into the journal, reports a limit that
+ * 				was reached and removes the cgroup. Cgroups left busy by
+ * 				earlier jobs are retried. Call before journal_end().
+*******************************************************************************/
+void cgroup_reaped(pid_t pid)
+{
+	for (int i = JOBS.size - 1; i >= 0; i--)
+	{
+		if (JOBS.items[i].pid == 0)
+			remove_job(i);
+	}
+
+	int found = -1;
+	for (int i = 0; i < JOBS.size && found == -1; i++)
+	{
+		if (JOBS.items[i].pid == pid)
+			found = i;
+	}
+	if (found == -1)
+		return;
+
+	const char *path = JOBS.items[found].path;
+	struct CgroupUsage usage = {-1, -1, -1, -1, -1, -1, -1};
+	char text[FILE_SIZE];
+	if (read_file(path, "cpu.stat", text))
+	{
+		usage.usageUs = find_value(text, "usage_usec");
+		usage.userUs = find_value(text, "user_usec");
+		usage.systemUs = find_value(text, "system_usec");
+		usage.throttledUs = find_value(text, "throttled_usec");
+	}
+	if (read_file(path, "memory.peak", text))
+		usage.memoryPeak = atoll(text);
+	if (read_file(path, "memory.events", text))
+		usage.oomKills = find_value(text, "oom_kill");
+	if (read_file(path, "pids.events", text))
+		usage.pidsMaxHits = find_value(text, "max");
+	journal_cgroup(pid, &usage);
+
+	if (usage.oomKills > 0)
+		out_printf("limit: pid %d reached memory.max, %lld processes killed\n", pid,
+			usage.oomKills);
+	if (usage.pidsMaxHits > 0)
+		out_printf("limit: pid %d reached pids.max, %lld forks refused\n", pid,
+			usage.pidsMaxHits);
+
+	if (!remove_job(found))
+		JOBS.items[found].pid = 0;
+}
+
+
+/*******************************************************************************
+ * Function: cgroup_close_all()
+ * Description: Kills whatever is left in the jobs' cgroups and removes them.
+ * 				Used by exit after the background jobs have been shut down.
+*******************************************************************************/
+void cgroup_close_all(void)
+{
+	for (int i = 0; i < JOBS.size; i++)
+	{
+		int dirFd = open(JOBS.items[i].path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dirFd != -1)
+		{
+			write_file(dirFd, "cgroup.kill", "1");
+			close(dirFd);
+		}
+	}
+
+	struct timespec pause = {0, 5 * 1000000};
+	for (int tries = 0; tries < REMOVE_TRIES && JOBS.size > 0; tries++)
+	{
+		for (int i = JOBS.size - 1; i >= 0; i--)
+			remove_job(i);
+		if (JOBS.size > 0)
+			nanosleep(&pause, NULL);
+	}
+}
@@ -0,0 +1,50 @@
+/*******************************************************************************
+ * File: cgroup.h
+ * Description: Per-job cgroup v2 limits and accounting for the limit prefix:
+ * 					limit [-m MEM] [-c CPUS] [-p PIDS] command...
+ * 				runs command in a new leaf cgroup under the directory named by
+ * 				SMALLSH_CGROUP, which must be delegated to the user. MEM is a
+ * 				byte count with an optional K, M or G suffix for memory.max,
+ * 				CPUS a number of CPUs such as 0.5 for cpu.max and PIDS the
+ * 				pids.max. When the job is reaped its cgroup's cpu.stat and
+ * 				memory.peak are read, which unlike rusage include every
+ * 				process it started, and go into the journal. Limits are best
+ * 				effort: without cgroup v2 delegation, or a controller, a
+ * 				warning is printed and the command runs without them.
+*******************************************************************************/
+#ifndef CGROUP_INCLUDED
+#define CGROUP_INCLUDED 1
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+// Struct for the limits given to a job, 0 for no limit
+struct CgroupLimits
+{
+	bool enabled; // Run in its own cgroup, even with no limits
+	long long memoryMax; // Bytes
+	long long cpuQuotaUs; // Per CPU_PERIOD_US
+	long long pidsMax;
+};
+
+// Struct for what a job's whole process tree used, -1 where not available
+struct CgroupUsage
+{
+	long long usageUs;
+	long long userUs;
+	long long systemUs;
+	long long throttledUs;
+	long long memoryPeak; // Bytes
+	long long oomKills;
+	long long pidsMaxHits; // Forks refused by pids.max
+};
+
+bool parse_memory_size(const char *text, long long *bytes);
+bool parse_cpu_quota(const char *text, long long *quotaUs);
+int cgroup_prepare(const struct CgroupLimits *limits, char **path);
+void cgroup_join(int cgroupFd);
+void cgroup_track(pid_t pid, int cgroupFd, char *path);
+void cgroup_reaped(pid_t pid);
+void cgroup_close_all(void);
+
+#endif
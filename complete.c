@@ -0,0 +1,183 @@
+/*******************************************************************************
+ * File: complete.c
+ * Description: Implements TAB completion. Command names come from the PATH
+ * 				trie, which is built on the first completion that needs it and
+ * 				synced with inotify before every use after that. File names are
+ * 				read from the word's directory each time.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "pathtrie.h"
+#include "complete.h"
+
+// Constants
+#define MAX_PATH 4096
+
+
+/*******************************************************************************
+ * Function: split_path(const char *word, char *dir, const char **base)
+ * Description: Splits a file path being completed into the directory to read
+ * 				(stored in dir, "." if there is none) and the partial file name
+ * 				after the last / (pointed to by base).
+*******************************************************************************/
+static void split_path(const char *word, char *dir, const char **base)
+{
+	const char *slash = strrchr(word, '/');
+	if (slash == NULL)
+	{
+		strcpy(dir, ".");
+		*base = word;
+	}
+	else if (slash == word)
+	{
+		strcpy(dir, "/");
+		*base = slash + 1;
+	}
+	else
+	{
+		snprintf(dir, MAX_PATH, "%.*s", (int)(slash - word), word);
+		*base = slash + 1;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: wants_entry(const char *name, const char *base)
+ * Description: Returns true if directory entry name completes base. Hidden
+ * 				files are only offered once the user has typed the dot.
+*******************************************************************************/
+static bool wants_entry(const char *name, const char *base)
+{
+	if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+		return false;
+	if (name[0] == '.' && base[0] != '.')
+		return false;
+	return strncmp(name, base, strlen(base)) == 0;
+}
+
+
+/*******************************************************************************
+ * Function: complete_file(const char *word, char *extension, int extensionSize, bool *isDir)
+ * Description: Completes word as a file path. Returns the number of matching
+ * 				entries and stores the text they all share after word in
+ * 				extension. isDir is set if the only match is a directory.
+*******************************************************************************/
+static int complete_file(const char *word, char *extension, int extensionSize, bool *isDir)
+{
+	char dir[MAX_PATH];
+	const char *base;
+	split_path(word, dir, &base);
+	int baseLen = strlen(base);
+
+	DIR *stream = opendir(dir);
+	if (stream == NULL)
+		return 0;
+
+	// Shrink the common extension with each match
+	int count = 0;
+	int common = 0;
+	char match[MAX_PATH] = "";
+	struct dirent *entry;
+	while ((entry = readdir(stream)) != NULL)
+	{
+		if (!wants_entry(entry->d_name, base))
+			continue;
+
+		if (count == 0)
+		{
+			snprintf(match, sizeof(match), "%s", entry->d_name);
+			common = strlen(match);
+		}
+		else
+		{
+			int i = baseLen;
+			while (i < common && match[i] == entry->d_name[i])
+				i++;
+			common = i;
+		}
+		count++;
+	}
+	closedir(stream);
+
+	snprintf(extension, extensionSize, "%.*s", common - baseLen, match + baseLen);
+	*isDir = false;
+	if (count == 1)
+	{
+		char full[MAX_PATH * 2];
+		struct stat info;
+		snprintf(full, sizeof(full), "%s/%s", dir, match);
+		*isDir = stat(full, &info) == 0 && S_ISDIR(info.st_mode);
+	}
+	return count;
+}
+
+
+/*******************************************************************************
+ * Function: complete_word(const char *word, bool isCommand, char *extension, int extensionSize, bool *isDir)
+ * Description: Completes the word under the cursor. isCommand is true when the
+ * 				word is the command name. Returns the number of candidates and
+ * 				stores the text every candidate shares after word in extension.
+ * 				isDir is set when the single candidate is a directory.
+*******************************************************************************/
+int complete_word(const char *word, bool isCommand, char *extension,
+	int extensionSize, bool *isDir)
+{
+	*isDir = false;
+	if (isCommand && strchr(word, '/') == NULL)
+	{
+		if (path_trie_built())
+			path_trie_sync();
+		if (!path_trie_built())
+			path_trie_build();
+		return path_trie_complete(word, extension, extensionSize);
+	}
+	return complete_file(word, extension, extensionSize, isDir);
+}
+
+
+/*******************************************************************************
+ * Function: compare_names(const void *a, const void *b)
+ * Description: qsort() comparison for an array of strings.
+*******************************************************************************/
+static int compare_names(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+
+/*******************************************************************************
+ * Function: complete_list(const char *word, bool isCommand, char *names[], int maxNames)
+ * Description: Fills names with up to maxNames sorted candidates for word and
+ * 				returns how many were stored. The caller frees each name.
+*******************************************************************************/
+int complete_list(const char *word, bool isCommand, char *names[], int maxNames)
+{
+	if (isCommand && strchr(word, '/') == NULL)
+		return path_trie_list(word, names, maxNames);
+
+	char dir[MAX_PATH];
+	const char *base;
+	split_path(word, dir, &base);
+
+	DIR *stream = opendir(dir);
+	if (stream == NULL)
+		return 0;
+
+	int count = 0;
+	struct dirent *entry;
+	while ((entry = readdir(stream)) != NULL && count < maxNames)
+	{
+		if (wants_entry(entry->d_name, base))
+			names[count++] = strdup(entry->d_name);
+	}
+	closedir(stream);
+
+	qsort(names, count, sizeof(char *), compare_names);
+	return count;
+}
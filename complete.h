@@ -0,0 +1,16 @@
+/*******************************************************************************
+ * File: complete.h
+ * Description: TAB completion for the line editor. The first word of a line is
+ * 				completed from the $PATH executable trie, any other word (or a
+ * 				word containing a /) as a file path.
+*******************************************************************************/
+#ifndef COMPLETE_INCLUDED
+#define COMPLETE_INCLUDED 1
+
+#include <stdbool.h>
+
+int complete_word(const char *word, bool isCommand, char *extension,
+	int extensionSize, bool *isDir);
+int complete_list(const char *word, bool isCommand, char *names[], int maxNames);
+
+#endif
@@ -0,0 +1,163 @@
+/*******************************************************************************
+ * File: coproc.c
+ * Description: Implements the coprocess table described in coproc.h. The
+ * 				shell's ends of the pipes are close on exec, so commands run
+ * 				later only get one through an explicit >& or <& redirect and a
+ * 				coprocess sees end of file as soon as the shell closes its
+ * 				write end.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include "output.h"
+#include "envstore.h"
+#include "vec.h"
+#include "coproc.h"
+
+// Constants
+#define NAME_LEN 256
+
+// A running coprocess
+struct Coproc
+{
+	pid_t pid;
+	char *name;
+	int readFd; // Its stdout
+	int writeFd; // Its stdin, -1 once closed
+};
+
+VEC_DECLARE(CoprocVec, coproc_vec, struct Coproc)
+
+// Globals
+static CoprocVec COPROCS = {NULL, 0, 0};
+
+
+/*******************************************************************************
+ * Function: set_variable(const char *name, const char *suffix, long value)
+ * Description: Sets NAME_SUFFIX to value, or removes it if value is -1.
+*******************************************************************************/
+static void set_variable(const char *name, const char *suffix, long value)
+{
+	char variable[NAME_LEN + 8], text[32];
+	snprintf(variable, sizeof(variable), "%s_%s", name, suffix);
+	if (value == -1)
+	{
+		env_unset(variable);
+		return;
+	}
+	snprintf(text, sizeof(text), "%ld", value);
+	env_set(variable, text);
+}
+
+
+/*******************************************************************************
+ * Function: coproc_start(char *arguments[], pid_t (*spawn)(char *command[],
+ * 				int stdinFd, int stdoutFd))
+ * Description: Takes in the coproc builtin's args and the function that starts
+ * 				a background command on the given fds and returns its pid.
+ * 				Starts the coprocess and sets its variables. Returns the pid,
+ * 				or -1 after displaying a message if it was not started.
+*******************************************************************************/
+pid_t coproc_start(char *arguments[], pid_t (*spawn)(char *command[], int stdinFd,
+	int stdoutFd))
+{
+	char *name = arguments[1];
+	if (name == NULL || arguments[2] == NULL || !env_valid_name(name) ||
+		strlen(name) >= NAME_LEN)
+	{
+		out_printf("usage: coproc NAME command...\n");
+		return -1;
+	}
+	for (int i = 0; i < COPROCS.size; i++)
+	{
+		if (strcmp(COPROCS.items[i].name, name) == 0)
+		{
+			out_printf("coproc: %s is already running\n", name);
+			return -1;
+		}
+	}
+
+	int toChild[2], fromChild[2];
+	if (pipe2(toChild, O_CLOEXEC) == -1)
+	{
+		out_printf("coproc: %s\n", strerror(errno));
+		return -1;
+	}
+	if (pipe2(fromChild, O_CLOEXEC) == -1)
+	{
+		out_printf("coproc: %s\n", strerror(errno));
+		close(toChild[0]);
+		close(toChild[1]);
+		return -1;
+	}
+
+	pid_t pid = spawn(&arguments[2], toChild[0], fromChild[1]);
+	close(toChild[0]);
+	close(fromChild[1]);
+	if (pid <= 0)
+	{
+		close(toChild[1]);
+		close(fromChild[0]);
+		return -1;
+	}
+
+	struct Coproc coproc = {pid, strdup(name), fromChild[0], toChild[1]};
+	coproc_vec_push(&COPROCS, coproc);
+	set_variable(name, "R", coproc.readFd);
+	set_variable(name, "W", coproc.writeFd);
+	set_variable(name, "PID", pid);
+	return pid;
+}
+
+
+/*******************************************************************************
+ * Function: coproc_reaped(pid_t pid)
+ * Description: Forgets a coprocess that has been reaped, closing the shell's
+ * 				ends of its pipes and removing its variables. Does nothing for
+ * 				any other pid.
+*******************************************************************************/
+void coproc_reaped(pid_t pid)
+{
+	for (int i = 0; i < COPROCS.size; i++)
+	{
+		struct Coproc *coproc = &COPROCS.items[i];
+		if (coproc->pid != pid)
+			continue;
+
+		close(coproc->readFd);
+		if (coproc->writeFd != -1)
+			close(coproc->writeFd);
+		set_variable(coproc->name, "R", -1);
+		set_variable(coproc->name, "W", -1);
+		set_variable(coproc->name, "PID", -1);
+		free(coproc->name);
+		coproc_vec_swap_remove(&COPROCS, i);
+		return;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: coproc_close_all()
+ * Description: Closes the write end of every coprocess so the ones that stop
+ * 				at end of file can finish on their own. Used by exit before
+ * 				the background jobs are signaled.
+*******************************************************************************/
+void coproc_close_all(void)
+{
+	for (int i = 0; i < COPROCS.size; i++)
+	{
+		if (COPROCS.items[i].writeFd != -1)
+		{
+			close(COPROCS.items[i].writeFd);
+			COPROCS.items[i].writeFd = -1;
+		}
+	}
+}
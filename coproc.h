@@ -0,0 +1,24 @@
+/*******************************************************************************
+ * File: coproc.h
+ * Description: Coprocesses for the coproc builtin:
+ * 					coproc NAME command...
+ * 				starts command in the background with its stdin and stdout
+ * 				connected to pipes held by the shell, and sets NAME_W to the
+ * 				fd that writes to its stdin, NAME_R to the fd that reads its
+ * 				stdout and NAME_PID to its pid. Later lines talk to it with
+ * 				>&$NAME_W and <&$NAME_R, so a tool that is slow to start is
+ * 				started once instead of once per use. It is a background job
+ * 				like any other; when it is reaped its fds are closed and the
+ * 				variables removed.
+*******************************************************************************/
+#ifndef COPROC_INCLUDED
+#define COPROC_INCLUDED 1
+
+#include <sys/types.h>
+
+pid_t coproc_start(char *arguments[], pid_t (*spawn)(char *command[], int stdinFd,
+	int stdoutFd));
+void coproc_reaped(pid_t pid);
+void coproc_close_all(void);
+
+#endif
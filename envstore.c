@@ -0,0 +1,309 @@
+/*******************************************************************************
+ * File: envstore.c
+ * Description: Implements the shell's environment store. Each variable is kept
+ * 				as one "NAME=value" string in a chained hash map, loaded from
+ * 				environ the first time the store is used. env_block() flattens
+ * 				the map into an envp array for execve() and keeps it until a
+ * 				variable changes, so spawning a command does not copy the
+ * 				environment. env_overlay() builds a separate array for a
+ * 				command's own assignments, sharing the strings of the block.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "envstore.h"
+
+// Constants
+#define NUM_BUCKETS 256
+
+// A variable in the hash map
+struct EnvVar
+{
+	char *entry; // "NAME=value", as passed to exec
+	size_t nameLen;
+	struct EnvVar *next;
+};
+
+// Globals
+extern char **environ;
+static struct EnvVar *BUCKETS[NUM_BUCKETS];
+static int NUM_VARS = 0;
+static bool LOADED = false;
+static char **BLOCK = NULL; // Cached envp, NULL when it needs a rebuild
+
+
+/*******************************************************************************
+ * Function: name_length(const char *text)
+ * Description: Returns the length of the name at the start of text, which ends
+ * 				at an = or the end of the string.
+*******************************************************************************/
+static size_t name_length(const char *text)
+{
+	return strcspn(text, "=");
+}
+
+
+/*******************************************************************************
+ * Function: hash_name(const char *name, size_t len)
+ * Description: FNV-1a hash of a variable name, reduced to a bucket index.
+*******************************************************************************/
+static unsigned hash_name(const char *name, size_t len)
+{
+	unsigned hash = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return hash % NUM_BUCKETS;
+}
+
+
+/*******************************************************************************
+ * Function: find_var(const char *name, size_t len)
+ * Description: Returns the variable with the given name, or NULL if it is not
+ * 				set.
+*******************************************************************************/
+static struct EnvVar *find_var(const char *name, size_t len)
+{
+	struct EnvVar *var = BUCKETS[hash_name(name, len)];
+	while (var != NULL)
+	{
+		if (var->nameLen == len && strncmp(var->entry, name, len) == 0)
+			return var;
+		var = var->next;
+	}
+	return NULL;
+}
+
+
+/*******************************************************************************
+ * Function: store_entry(char *entry)
+ * Description: Takes ownership of a "NAME=value" string and stores it,
+ * 				replacing any variable with the same name. The cached block is
+ * 				dropped.
+*******************************************************************************/
+static void store_entry(char *entry)
+{
+	size_t len = name_length(entry);
+	struct EnvVar *var = find_var(entry, len);
+
+	if (var != NULL)
+	{
+		free(var->entry);
+		var->entry = entry;
+	}
+	else
+	{
+		unsigned bucket = hash_name(entry, len);
+		var = malloc(sizeof(struct EnvVar));
+		var->entry = entry;
+		var->nameLen = len;
+		var->next = BUCKETS[bucket];
+		BUCKETS[bucket] = var;
+		NUM_VARS++;
+	}
+
+	free(BLOCK);
+	BLOCK = NULL;
+}
+
+
+/*******************************************************************************
+ * Function: load_environ()
+ * Description: Copies the process environment into the store on first use.
+*******************************************************************************/
+static void load_environ(void)
+{
+	if (LOADED)
+		return;
+	LOADED = true;
+
+	for (char **entry = environ; entry != NULL && *entry != NULL; entry++)
+	{
+		if (strchr(*entry, '=') != NULL)
+			store_entry(strdup(*entry));
+	}
+}
+
+
+/*******************************************************************************
+ * Function: env_get(const char *name)
+ * Description: Returns the value of a variable, or NULL if it is not set. The
+ * 				value stays valid until the variable is changed.
+*******************************************************************************/
+const char *env_get(const char *name)
+{
+	load_environ();
+
+	size_t len = strlen(name);
+	struct EnvVar *var = find_var(name, len);
+	if (var == NULL)
+		return NULL;
+	return var->entry + len + 1;
+}
+
+
+/*******************************************************************************
+ * Function: env_set(const char *name, const char *value)
+ * Description: Sets a variable, adding it if it is not already set.
+*******************************************************************************/
+void env_set(const char *name, const char *value)
+{
+	load_environ();
+
+	size_t nameLen = strlen(name);
+	size_t valueLen = strlen(value);
+	char *entry = malloc(nameLen + valueLen + 2);
+	memcpy(entry, name, nameLen);
+	entry[nameLen] = '=';
+	memcpy(entry + nameLen + 1, value, valueLen + 1);
+	store_entry(entry);
+}
+
+
+/*******************************************************************************
+ * Function: env_put(const char *assignment)
+ * Description: Sets a variable from a "NAME=value" string.
+*******************************************************************************/
+void env_put(const char *assignment)
+{
+	load_environ();
+	store_entry(strdup(assignment));
+}
+
+
+/*******************************************************************************
+ * Function: env_unset(const char *name)
+ * Description: Removes a variable. Does nothing if it is not set.
+*******************************************************************************/
+void env_unset(const char *name)
+{
+	load_environ();
+
+	size_t len = strlen(name);
+	struct EnvVar **link = &BUCKETS[hash_name(name, len)];
+	while (*link != NULL)
+	{
+		struct EnvVar *var = *link;
+		if (var->nameLen == len && strncmp(var->entry, name, len) == 0)
+		{
+			*link = var->next;
+			free(var->entry);
+			free(var);
+			NUM_VARS--;
+
+			free(BLOCK);
+			BLOCK = NULL;
+			return;
+		}
+		link = &var->next;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: env_valid_name(const char *name)
+ * Description: Returns true if name is a valid variable name: a letter or
+ * 				underscore followed by letters, digits and underscores.
+*******************************************************************************/
+bool env_valid_name(const char *name)
+{
+	size_t len = name_length(name);
+	if (len == 0 || (name[0] >= '0' && name[0] <= '9'))
+		return false;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		char c = name[i];
+		if (!(c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+			(c >= '0' && c <= '9')))
+			return false;
+	}
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: env_is_assignment(const char *word)
+ * Description: Returns true if word has the form NAME=value.
+*******************************************************************************/
+bool env_is_assignment(const char *word)
+{
+	return strchr(word, '=') != NULL && env_valid_name(word);
+}
+
+
+/*******************************************************************************
+ * Function: env_block()
+ * Description: Returns the NULL terminated envp array for the current
+ * 				variables. The array is rebuilt only if a variable changed
+ * 				since the last call. It must not be freed or modified.
+*******************************************************************************/
+char **env_block(void)
+{
+	load_environ();
+	if (BLOCK != NULL)
+		return BLOCK;
+
+	BLOCK = malloc((NUM_VARS + 1) * sizeof(char *));
+
+	int count = 0;
+	for (int i = 0; i < NUM_BUCKETS; i++)
+	{
+		for (struct EnvVar *var = BUCKETS[i]; var != NULL; var = var->next)
+			BLOCK[count++] = var->entry;
+	}
+	BLOCK[count] = NULL;
+	return BLOCK;
+}
+
+
+/*******************************************************************************
+ * Function: env_overlay(char *assignments[], int numAssignments)
+ * Description: Takes in a command's NAME=value assignments. Returns a new envp
+ * 				array holding the current variables with the assignments
+ * 				applied; later assignments win over earlier ones. Only the
+ * 				array is allocated, the strings are shared with the block and
+ * 				the assignments. The shell's own variables are not changed.
+ * 				The caller frees the array.
+*******************************************************************************/
+char **env_overlay(char *assignments[], int numAssignments)
+{
+	char **block = env_block();
+	char **envp = malloc((NUM_VARS + numAssignments + 1) * sizeof(char *));
+	int count = 0;
+
+	// Variables that no assignment replaces
+	for (int i = 0; block[i] != NULL; i++)
+	{
+		size_t len = name_length(block[i]);
+		bool replaced = false;
+		for (int j = 0; j < numAssignments && !replaced; j++)
+		{
+			replaced = name_length(assignments[j]) == len &&
+				strncmp(assignments[j], block[i], len) == 0;
+		}
+		if (!replaced)
+			envp[count++] = block[i];
+	}
+
+	// Assignments, keeping only the last one for each name
+	for (int j = 0; j < numAssignments; j++)
+	{
+		size_t len = name_length(assignments[j]);
+		bool overridden = false;
+		for (int k = j + 1; k < numAssignments && !overridden; k++)
+		{
+			overridden = name_length(assignments[k]) == len &&
+				strncmp(assignments[k], assignments[j], len) == 0;
+		}
+		if (!overridden)
+			envp[count++] = assignments[j];
+	}
+
+	envp[count] = NULL;
+	return envp;
+}
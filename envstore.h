@@ -0,0 +1,24 @@
+/*******************************************************************************
+ * File: envstore.h
+ * Description: Environment owned by the shell. Variables live in a hash map
+ * 				and are handed to exec as a flattened envp array that is only
+ * 				rebuilt after a change. A command's own NAME=value assignments
+ * 				are layered over it without changing the shell's variables.
+*******************************************************************************/
+#ifndef ENVSTORE_INCLUDED
+#define ENVSTORE_INCLUDED 1
+
+#include <stdbool.h>
+
+const char *env_get(const char *name);
+void env_set(const char *name, const char *value);
+void env_put(const char *assignment);
+void env_unset(const char *name);
+
+bool env_is_assignment(const char *word);
+bool env_valid_name(const char *name);
+
+char **env_block(void);
+char **env_overlay(char *assignments[], int numAssignments);
+
+#endif
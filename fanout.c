@@ -0,0 +1,338 @@
+/*******************************************************************************
+ * File: fanout.c
+ * Description: Implements fanout_copy(). Each round tee()s the data waiting in
+ * 				the source pipe into every sink's pipe but one, then splice()s
+ * 				it into the last, which also removes it from the source. A
+ * 				file sink gets a staging pipe that is spliced into the file.
+ *
+ * 				tee() stops short when the pipe it writes to runs out of
+ * 				slots, and it always starts at the front of the source, so
+ * 				every sink must take the same amount each round. All the
+ * 				sink pipes are given the same size and have been sent the same
+ * 				buffers, so the one holding the most unread bytes has the
+ * 				fewest free slots. The round is sized by tee()ing into that
+ * 				one first; the rest then always have room for it. When that
+ * 				pipe is full the shell waits for it in poll() without reading
+ * 				the source, which is the backpressure on the producer.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include "output.h"
+#include "fanout.h"
+
+// Constants
+#define PIPE_SIZE (1024 * 1024) // Asked for each pipe; limits may give less
+#define CHUNK_SIZE (1024 * 1024)
+#define BUFFER_SIZE (64 * 1024) // For files that cannot be spliced into
+
+// One sink
+struct Sink
+{
+	int out; // Pipe the shell writes to
+	int stage; // Read end of a file sink's staging pipe, or -1
+	int file; // A file sink's file, or -1
+	bool canSplice; // The file takes splice()
+	bool open;
+};
+
+
+/*******************************************************************************
+ * Function: close_sink(struct Sink *sink, int *numOpen)
+ * Description: Stops sending to a sink whose reader has gone, has fallen
+ * 				behind or whose file cannot be written. A command's pipe is
+ * 				closed so it sees end of file; a file's is closed at the end.
+*******************************************************************************/
+static void close_sink(struct Sink *sink, int *numOpen)
+{
+	if (!sink->open)
+		return;
+	sink->open = false;
+	(*numOpen)--;
+	if (sink->file == -1)
+	{
+		close(sink->out);
+		sink->out = -1;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: drain_file(struct Sink *sink, bool wait)
+ * Description: Moves what is in a file sink's staging pipe into the file. If
+ * 				wait is false it stops once the pipe is empty, otherwise once
+ * 				the pipe has been closed and emptied. Returns false if the file
+ * 				could not be written.
+*******************************************************************************/
+static bool drain_file(struct Sink *sink, bool wait)
+{
+	char *buffer = NULL;
+	bool ok = true;
+	while (ok)
+	{
+		ssize_t moved;
+		if (sink->canSplice)
+		{
+			moved = splice(sink->stage, NULL, sink->file, NULL, CHUNK_SIZE,
+				SPLICE_F_MOVE | (wait ? 0 : SPLICE_F_NONBLOCK));
+			if (moved == -1 && errno == EINVAL)
+			{
+				sink->canSplice = false;
+				continue;
+			}
+		}
+		else
+		{
+			if (buffer == NULL)
+				buffer = malloc(BUFFER_SIZE);
+			int pending = 0;
+			ioctl(sink->stage, FIONREAD, &pending);
+			if (!wait && pending == 0)
+				break;
+			moved = read(sink->stage, buffer, BUFFER_SIZE);
+			for (ssize_t done = 0; moved > 0 && done < moved; )
+			{
+				ssize_t written = write(sink->file, buffer + done, moved - done);
+				if (written == -1)
+				{
+					ok = false;
+					break;
+				}
+				done += written;
+			}
+		}
+
+		if (moved == 0 || (moved == -1 && errno == EAGAIN))
+			break;
+		if (moved == -1 && errno != EINTR)
+			ok = false;
+	}
+	free(buffer);
+	return ok;
+}
+
+
+/*******************************************************************************
+ * Function: size_pipes(int source, struct Sink sinks[], int numSinks)
+ * Description: Enlarges the pipes and then makes every sink pipe the size of
+ * 				the smallest, which the round sizing depends on.
+*******************************************************************************/
+static void size_pipes(int source, struct Sink sinks[], int numSinks)
+{
+	fcntl(source, F_SETPIPE_SZ, PIPE_SIZE);
+	int smallest = -1;
+	for (int i = 0; i < numSinks; i++)
+	{
+		fcntl(sinks[i].out, F_SETPIPE_SZ, PIPE_SIZE);
+		int size = fcntl(sinks[i].out, F_GETPIPE_SZ);
+		if (smallest == -1 || size < smallest)
+			smallest = size;
+	}
+	for (int i = 0; i < numSinks; i++)
+	{
+		if (fcntl(sinks[i].out, F_GETPIPE_SZ) != smallest)
+			fcntl(sinks[i].out, F_SETPIPE_SZ, smallest);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: move_all(int source, int out, size_t len)
+ * Description: Splices len bytes from source into out, waiting for room.
+ * 				Returns how many were moved, which is less than len only if
+ * 				out's reader has gone.
+*******************************************************************************/
+static size_t move_all(int source, int out, size_t len)
+{
+	size_t done = 0;
+	while (done < len)
+	{
+		ssize_t moved = splice(source, NULL, out, NULL, len - done, SPLICE_F_MOVE);
+		if (moved == -1 && errno == EINTR)
+			continue;
+		if (moved <= 0)
+			break;
+		done += moved;
+	}
+	return done;
+}
+
+
+/*******************************************************************************
+ * Function: fanout_copy(int source, int sinks[], int numSinks, int watchFd,
+ * 				void (*onWatch)(void))
+ * Description: Takes in the read end of the producer's pipe and the sinks:
+ * 				write ends of pipes to sink commands, or files. Copies
+ * 				everything from source to every sink until the producer closes
+ * 				its end or no sink is left. onWatch() is called whenever
+ * 				watchFd is readable while waiting. A command sink that is
+ * 				dropped is closed and set to -1 in sinks; the rest are not.
+ * 				Returns the number of bytes read from source, or -1 if the
+ * 				fan-out could not be set up.
+*******************************************************************************/
+long long fanout_copy(int source, int sinks[], int numSinks, int watchFd,
+	void (*onWatch)(void))
+{
+	// A sink that goes away shows up as EPIPE instead of killing the shell
+	struct sigaction ignoreAction = {0}, oldAction;
+	ignoreAction.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &ignoreAction, &oldAction);
+
+	struct Sink *sink = calloc(numSinks, sizeof(struct Sink));
+	int numOpen = 0;
+	bool ok = true;
+	for (int i = 0; i < numSinks && ok; i++)
+	{
+		struct stat info;
+		sink[i].stage = sink[i].file = -1;
+		sink[i].open = true;
+		numOpen++;
+		if (fstat(sinks[i], &info) == 0 && S_ISFIFO(info.st_mode))
+		{
+			sink[i].out = sinks[i];
+			continue;
+		}
+
+		int stage[2];
+		ok = pipe2(stage, O_CLOEXEC) == 0;
+		sink[i].stage = ok ? stage[0] : -1;
+		sink[i].out = ok ? stage[1] : -1;
+		sink[i].file = sinks[i];
+		sink[i].canSplice = true;
+	}
+	int discard = open("/dev/null", O_WRONLY | O_CLOEXEC);
+	if (!ok || discard == -1)
+		numOpen = 0;
+	else
+		size_pipes(source, sink, numSinks);
+
+	long long total = 0;
+	while (numOpen > 0)
+	{
+		for (int i = 0; i < numSinks; i++)
+		{
+			if (sink[i].open && sink[i].file != -1 && !drain_file(&sink[i], false))
+			{
+				out_printf("|>: write error on sink %d: %s\n", i + 1, strerror(errno));
+				close_sink(&sink[i], &numOpen);
+			}
+		}
+
+		// The sink with the most unread bytes has the least room
+		int fullest = -1, last = -1, most = -1;
+		for (int i = 0; i < numSinks; i++)
+		{
+			int pending = 0;
+			if (!sink[i].open)
+				continue;
+			ioctl(sink[i].out, FIONREAD, &pending);
+			if (pending > most)
+			{
+				most = pending;
+				fullest = i;
+			}
+		}
+		for (int i = 0; i < numSinks; i++)
+		{
+			if (sink[i].open && i != fullest)
+				last = i;
+		}
+		if (fullest == -1)
+			break;
+
+		// With one sink left it simply takes the data
+		ssize_t len;
+		if (last == -1)
+			len = splice(source, NULL, sink[fullest].out, NULL, CHUNK_SIZE,
+				SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		else
+			len = tee(source, sink[fullest].out, CHUNK_SIZE, SPLICE_F_NONBLOCK);
+
+		if (len == 0)
+			break;
+		if (len == -1)
+		{
+			if (errno == EPIPE)
+			{
+				close_sink(&sink[fullest], &numOpen);
+			}
+			else if (errno == EAGAIN)
+			{
+				// Wait for whichever side blocked: the source is empty or the
+				// fullest sink is full
+				int unread = 0;
+				ioctl(source, FIONREAD, &unread);
+				struct pollfd fds[2] = {
+					{(unread == 0) ? source : sink[fullest].out,
+						(unread == 0) ? POLLIN : POLLOUT, 0},
+					{watchFd, POLLIN, 0}
+				};
+				poll(fds, 2, -1);
+				if ((fds[1].revents & POLLIN) && onWatch != NULL)
+					onWatch();
+			}
+			else if (errno != EINTR)
+			{
+				out_printf("|>: %s\n", strerror(errno));
+				break;
+			}
+			continue;
+		}
+		total += len;
+		if (last == -1)
+			continue;
+
+		for (int i = 0; i < numSinks; i++)
+		{
+			if (!sink[i].open || i == fullest || i == last)
+				continue;
+			ssize_t copied = tee(source, sink[i].out, len, SPLICE_F_NONBLOCK);
+			if (copied != len)
+			{
+				if (copied != -1 || errno != EPIPE)
+					out_printf("|>: sink %d fell behind\n", i + 1);
+				close_sink(&sink[i], &numOpen);
+			}
+		}
+
+		// Taking it from the source; if the last sink is gone it is dropped
+		size_t moved = move_all(source, sink[last].out, len);
+		if (moved < (size_t)len)
+		{
+			close_sink(&sink[last], &numOpen);
+			move_all(source, discard, len - moved);
+		}
+	}
+
+	// Finish writing the files
+	for (int i = 0; i < numSinks; i++)
+	{
+		if (sink[i].stage == -1)
+			continue;
+		close(sink[i].out);
+		if (sink[i].open && !drain_file(&sink[i], true))
+			out_printf("|>: write error on sink %d: %s\n", i + 1, strerror(errno));
+		close(sink[i].stage);
+	}
+	for (int i = 0; i < numSinks; i++)
+	{
+		if (sink[i].file == -1 && sink[i].out == -1)
+			sinks[i] = -1;
+	}
+	if (discard != -1)
+		close(discard);
+	free(sink);
+	sigaction(SIGPIPE, &oldAction, NULL);
+	return ok ? total : -1;
+}
@@ -0,0 +1,19 @@
+/*******************************************************************************
+ * File: fanout.h
+ * Description: Fan-out for the |> operator:
+ * 					command |> sink, sink, ...
+ * 				sends everything command writes to every sink. A sink is a
+ * 				command, which reads the data on its stdin, or > FILE or
+ * 				>> FILE, which the shell writes itself. The shell sits between
+ * 				the pipes and duplicates the data with tee() and splice(), so
+ * 				it is never copied through the shell's memory. The producer
+ * 				can only run as fast as the slowest sink: nothing more is read
+ * 				from it while any sink's pipe is full.
+*******************************************************************************/
+#ifndef FANOUT_INCLUDED
+#define FANOUT_INCLUDED 1
+
+long long fanout_copy(int source, int sinks[], int numSinks, int watchFd,
+	void (*onWatch)(void));
+
+#endif
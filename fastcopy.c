@@ -0,0 +1,133 @@
+/*******************************************************************************
+ * File: fastcopy.c
+ * Description: Implements copy_fd(). The cheapest method that works for the
+ * 				two descriptors is used, and the next one is tried whenever the
+ * 				kernel refuses a method:
+ * 					copy_file_range() - file to file, may share extents
+ * 					sendfile()        - from a regular file to anything
+ * 					splice()          - when either side is a pipe
+ * 					read()/write()    - everything else, such as terminals
+ * 				All of them use the descriptors' file offsets, so falling back
+ * 				partway through carries on where the last method stopped.
+ * 				Files in /proc and /sys report a size of 0 and are copied with
+ * 				read()/write(), since the in-kernel methods would copy nothing.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "fastcopy.h"
+#include "util.h"
+
+// Constants
+#define CHUNK_SIZE (16 * 1024 * 1024) // Per call, so stop is checked regularly
+#define BUFFER_SIZE (128 * 1024)
+
+// The ways to copy, cheapest first
+enum CopyMethod
+{
+	COPY_RANGE,
+	COPY_SENDFILE,
+	COPY_SPLICE,
+	COPY_READ_WRITE
+};
+
+
+/*******************************************************************************
+ * Function: unsupported(int error)
+ * Description: Returns true if error means the method cannot be used for these
+ * 				descriptors, so the next one should be tried.
+*******************************************************************************/
+static bool unsupported(int error)
+{
+	return error == EINVAL || error == EXDEV || error == ENOSYS ||
+		error == EOPNOTSUPP || error == EBADF || error == ESPIPE;
+}
+
+
+/*******************************************************************************
+ * Function: first_method(int inFd, int outFd)
+ * Description: Picks the cheapest method worth trying for the descriptors.
+*******************************************************************************/
+static enum CopyMethod first_method(int inFd, int outFd)
+{
+	struct stat in, out;
+	if (fstat(inFd, &in) == -1 || fstat(outFd, &out) == -1)
+		return COPY_READ_WRITE;
+
+	if (S_ISREG(in.st_mode) && in.st_size > 0)
+		return S_ISREG(out.st_mode) ? COPY_RANGE : COPY_SENDFILE;
+	if (S_ISFIFO(in.st_mode) || S_ISFIFO(out.st_mode))
+		return COPY_SPLICE;
+	return COPY_READ_WRITE;
+}
+
+
+/*******************************************************************************
+ * Function: copy_fd(int inFd, int outFd, volatile sig_atomic_t *stop)
+ * Description: Copies from inFd's offset to its end into outFd. stop may point
+ * 				to a flag set by a signal handler; the copy ends with EINTR
+ * 				soon after it is set. Returns 0 on success, or -1 with errno
+ * 				set.
+*******************************************************************************/
+int copy_fd(int inFd, int outFd, volatile sig_atomic_t *stop)
+{
+	enum CopyMethod method = first_method(inFd, outFd);
+	char *buffer = NULL;
+
+	while (stop == NULL || !*stop)
+	{
+		ssize_t copied;
+		switch (method)
+		{
+			case COPY_RANGE:
+				copied = copy_file_range(inFd, NULL, outFd, NULL, CHUNK_SIZE, 0);
+				break;
+			case COPY_SENDFILE:
+				copied = sendfile(outFd, inFd, NULL, CHUNK_SIZE);
+				break;
+			case COPY_SPLICE:
+				copied = splice(inFd, NULL, outFd, NULL, CHUNK_SIZE, SPLICE_F_MOVE);
+				break;
+			default:
+				if (buffer == NULL)
+					buffer = malloc(BUFFER_SIZE);
+				copied = read(inFd, buffer, BUFFER_SIZE);
+				if (copied > 0 && !write_all(outFd, buffer, copied))
+					copied = -1;
+		}
+
+		if (copied == 0)
+		{
+			free(buffer);
+			return 0;
+		}
+		if (copied == -1)
+		{
+			if (errno == EINTR)
+				continue;
+			if (method != COPY_READ_WRITE && unsupported(errno))
+			{
+				// COPY_RANGE -> COPY_SENDFILE -> COPY_SPLICE -> COPY_READ_WRITE
+				method++;
+				continue;
+			}
+			int error = errno;
+			free(buffer);
+			errno = error;
+			return -1;
+		}
+	}
+
+	free(buffer);
+	errno = EINTR;
+	return -1;
+}
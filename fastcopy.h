@@ -0,0 +1,14 @@
+/*******************************************************************************
+ * File: fastcopy.h
+ * Description: Copies all remaining data between two file descriptors inside
+ * 				the kernel where possible. Used by the cat and cp builtins so
+ * 				copying a file does not need a fork and exec.
+*******************************************************************************/
+#ifndef FASTCOPY_INCLUDED
+#define FASTCOPY_INCLUDED 1
+
+#include <signal.h>
+
+int copy_fd(int inFd, int outFd, volatile sig_atomic_t *stop);
+
+#endif
@@ -0,0 +1,56 @@
+/*******************************************************************************
+ * File: heredoc.c
+ * Description: Implements the memfd files behind here-documents. The body is
+ * 				written while it is read, then the file is sealed against any
+ * 				further change and rewound, so the command reads exactly what
+ * 				the script held. The memfd lives only in memory (and swap) and
+ * 				is freed when the last descriptor to it is closed.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include "heredoc.h"
+#include "util.h"
+
+// Constants
+#define SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL)
+
+
+/*******************************************************************************
+ * Function: heredoc_open()
+ * Description: Creates an empty memfd for a body. Returns its descriptor, or
+ * 				-1 on error.
+*******************************************************************************/
+int heredoc_open(void)
+{
+	return memfd_create("smallsh-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+}
+
+
+/*******************************************************************************
+ * Function: heredoc_write(int fd, const char *data, size_t len)
+ * Description: Appends data to a body. Returns false on error.
+*******************************************************************************/
+bool heredoc_write(int fd, const char *data, size_t len)
+{
+	return write_all(fd, data, len);
+}
+
+
+/*******************************************************************************
+ * Function: heredoc_finish(int fd)
+ * Description: Seals a finished body so it can no longer change and rewinds
+ * 				it for reading. Returns false on error.
+*******************************************************************************/
+bool heredoc_finish(int fd)
+{
+	if (fcntl(fd, F_ADD_SEALS, SEALS) == -1)
+		return false;
+	return lseek(fd, 0, SEEK_SET) == 0;
+}
@@ -0,0 +1,17 @@
+/*******************************************************************************
+ * File: heredoc.h
+ * Description: Here-document and here-string bodies kept in sealed memfd
+ * 				files, so a command's stdin can come from the script without
+ * 				anything being written to the filesystem.
+*******************************************************************************/
+#ifndef HEREDOC_INCLUDED
+#define HEREDOC_INCLUDED 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+int heredoc_open(void);
+bool heredoc_write(int fd, const char *data, size_t len);
+bool heredoc_finish(int fd);
+
+#endif
@@ -0,0 +1,505 @@
+/*******************************************************************************
+ * File: history.c
+ * Description: Implements the smallsh history log. The log file is mapped with
+ * 				mmap and grown in chunks so appending a command is a memcpy
+ * 				rather than a write() per line. Every entry is indexed by the
+ * 				trigrams it contains; a search picks the shortest posting list
+ * 				for the query and walks it newest-first, verifying each
+ * 				candidate. Shells sharing the log take a flock() on it while
+ * 				they append or trim it, and pick up each other's entries.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include "dynArray.h"
+#include "vec.h"
+#include "history.h"
+
+// Constants
+#define HIST_CHUNK (1 << 20) // Log file grows 1 MB at a time
+#define NUM_BUCKETS (1 << 20) // Trigram hash buckets
+#define GRAM 3
+
+// Offsets into the map, which can pass INT_MAX in a long-lived log
+VEC_DECLARE(OffsetVec, offset_vec, size_t)
+
+// Globals
+static int HIST_FD = -1;
+static char *HIST_MAP = NULL;
+static size_t HIST_USED = 0; // Bytes of the map holding entries
+static size_t HIST_CAP = 0; // Bytes mapped (and size of the file)
+static pid_t HIST_OWNER = 0; // Only the shell itself may truncate the log
+static OffsetVec HIST_STARTS; // Offset of each entry in the map
+static DynArr *HIST_INDEX[NUM_BUCKETS]; // Trigram -> ascending entry ids
+static DynArr *HIST_HAS_BYTE[256]; // Byte -> ascending ids of entries holding it
+static DynArr *HIST_FIRST_BYTE[256]; // First byte -> ascending ids
+
+
+/*******************************************************************************
+ * Function: gram_bucket(const char *s)
+ * Description: Hashes the three bytes at s into a bucket of the trigram index.
+*******************************************************************************/
+static unsigned gram_bucket(const char *s)
+{
+	unsigned gram = ((unsigned char)s[0] << 16) | ((unsigned char)s[1] << 8) |
+		(unsigned char)s[2];
+	return (gram * 2654435761u) >> 12;
+}
+
+
+/*******************************************************************************
+ * Function: entry_len(int id)
+ * Description: Returns the length of entry id, not counting its newline.
+*******************************************************************************/
+static int entry_len(int id)
+{
+	size_t start = HIST_STARTS.items[id];
+	size_t end;
+	if (id + 1 < HIST_STARTS.size)
+		end = HIST_STARTS.items[id + 1];
+	else
+		end = HIST_USED;
+	return end - start - 1;
+}
+
+
+/*******************************************************************************
+ * Function: index_entry(int id)
+ * Description: Adds entry id to the posting list of every trigram it holds,
+ * 				counting its trailing newline as part of the entry. Ids are
+ * 				indexed in increasing order so every posting list stays sorted,
+ * 				and a trigram repeated within the entry is only added once.
+*******************************************************************************/
+static void index_entry(int id)
+{
+	const char *entry = HIST_MAP + HIST_STARTS.items[id];
+	int len = entry_len(id) + 1;
+
+	// Single characters are looked up in lists of their own
+	bool seen[256] = {false};
+	for (int i = 0; i < len; i++)
+	{
+		unsigned char byte = entry[i];
+		if (seen[byte])
+			continue;
+		seen[byte] = true;
+		if (HIST_HAS_BYTE[byte] == NULL)
+			HIST_HAS_BYTE[byte] = newDynArr(4);
+		addDynArr(HIST_HAS_BYTE[byte], id);
+	}
+	unsigned char first = entry[0];
+	if (HIST_FIRST_BYTE[first] == NULL)
+		HIST_FIRST_BYTE[first] = newDynArr(4);
+	addDynArr(HIST_FIRST_BYTE[first], id);
+
+	for (int i = 0; i + GRAM <= len; i++)
+	{
+		unsigned bucket = gram_bucket(entry + i);
+		if (HIST_INDEX[bucket] == NULL)
+			HIST_INDEX[bucket] = newDynArr(4);
+		else if (topDynArr(HIST_INDEX[bucket]) == id)
+			continue;
+		addDynArr(HIST_INDEX[bucket], id);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: map_resize(size_t newCap)
+ * Description: Makes the log file at least newCap bytes and maps all of it.
+ * 				Another shell may have grown the file further, or trimmed it
+ * 				below this shell's mapping when it exited, so the size is read
+ * 				again first. Called with the lock held. Returns false and
+ * 				leaves the old mapping in place if a step fails.
+*******************************************************************************/
+static bool map_resize(size_t newCap)
+{
+	struct stat info;
+	if (fstat(HIST_FD, &info) == -1)
+		return false;
+	if ((size_t)info.st_size > newCap)
+		newCap = info.st_size;
+	else if ((size_t)info.st_size < newCap && ftruncate(HIST_FD, newCap) == -1)
+		return false;
+	if (newCap == HIST_CAP)
+		return true;
+
+	char *map = mmap(NULL, newCap, PROT_READ | PROT_WRITE, MAP_SHARED, HIST_FD, 0);
+	if (map == MAP_FAILED)
+		return false;
+
+	if (HIST_MAP != NULL)
+		munmap(HIST_MAP, HIST_CAP);
+	HIST_MAP = map;
+	HIST_CAP = newCap;
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: read_new_entries()
+ * Description: Adds the entries after HIST_USED, up to the zero padding, to
+ * 				the offsets and index. At start up these are the whole log;
+ * 				later they are lines other shells appended. Called with the
+ * 				lock held.
+*******************************************************************************/
+static void read_new_entries(void)
+{
+	// Padding left behind by a shell that did not exit cleanly is all zeros
+	char *end = memchr(HIST_MAP + HIST_USED, '\0', HIST_CAP - HIST_USED);
+	size_t used = (end != NULL) ? (size_t)(end - HIST_MAP) : HIST_CAP;
+	if (used > HIST_USED && HIST_MAP[used-1] != '\n' && used < HIST_CAP)
+		HIST_MAP[used++] = '\n';
+
+	// Record where each entry starts, then index them oldest to newest
+	size_t pos = HIST_USED;
+	int firstId = HIST_STARTS.size;
+	while (pos < used)
+	{
+		offset_vec_push(&HIST_STARTS, pos);
+		char *newline = memchr(HIST_MAP + pos, '\n', used - pos);
+		pos = (newline != NULL) ? (size_t)(newline - HIST_MAP + 1) : used;
+	}
+	HIST_USED = used;
+	for (int id = firstId; id < HIST_STARTS.size; id++)
+		index_entry(id);
+}
+
+
+/*******************************************************************************
+ * Function: history_init(const char *path)
+ * Description: Opens (or creates) the history log at path, maps it, and builds
+ * 				the entry offsets and trigram index from its contents. The file
+ * 				is kept padded to a whole chunk while the shell runs; the padding
+ * 				is trimmed off by history_close() at exit. Returns false if the
+ * 				log could not be opened, leaving history disabled.
+*******************************************************************************/
+bool history_init(const char *path)
+{
+	HIST_FD = open(path, O_RDWR | O_CREAT, 0600);
+	if (HIST_FD == -1)
+		return false;
+	fcntl(HIST_FD, F_SETFD, FD_CLOEXEC);
+
+	struct stat info;
+	flock(HIST_FD, LOCK_EX);
+	if (fstat(HIST_FD, &info) == -1 || !map_resize(info.st_size + HIST_CHUNK))
+	{
+		flock(HIST_FD, LOCK_UN);
+		close(HIST_FD);
+		HIST_FD = -1;
+		return false;
+	}
+	offset_vec_init(&HIST_STARTS);
+	offset_vec_reserve(&HIST_STARTS, 1024);
+	read_new_entries();
+	flock(HIST_FD, LOCK_UN);
+
+	HIST_OWNER = getpid();
+	atexit(history_close);
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: history_close()
+ * Description: Trims the chunk padding off the log and unmaps it. The lines
+ * 				other shells appended are read first, so only padding is cut;
+ * 				a shell still running grows the file again when it next
+ * 				appends. Forked children that exit without exec'ing share the
+ * 				mapping, so only the process that opened the log may do this.
+*******************************************************************************/
+void history_close(void)
+{
+	if (HIST_FD == -1 || getpid() != HIST_OWNER)
+		return;
+
+	flock(HIST_FD, LOCK_EX);
+	if (map_resize(HIST_CAP))
+	{
+		read_new_entries();
+		ftruncate(HIST_FD, HIST_USED);
+	}
+	flock(HIST_FD, LOCK_UN);
+	munmap(HIST_MAP, HIST_CAP);
+	close(HIST_FD);
+	HIST_FD = -1;
+	HIST_MAP = NULL;
+}
+
+
+/*******************************************************************************
+ * Function: history_enabled()
+ * Description: Returns true if a history log is open.
+*******************************************************************************/
+bool history_enabled(void)
+{
+	return HIST_MAP != NULL;
+}
+
+
+/*******************************************************************************
+ * Function: history_add(const char *line)
+ * Description: Appends line (up to any newline) to the log and indexes it.
+ * 				The space is reserved under the lock after taking in any lines
+ * 				other shells appended, so concurrent sessions never write over
+ * 				each other.
+*******************************************************************************/
+void history_add(const char *line)
+{
+	if (!history_enabled())
+		return;
+
+	size_t len = strcspn(line, "\n");
+	if (len == 0)
+		return;
+
+	flock(HIST_FD, LOCK_EX);
+	if (!map_resize(HIST_CAP))
+	{
+		flock(HIST_FD, LOCK_UN);
+		return;
+	}
+	read_new_entries();
+
+	if (HIST_USED + len + 1 > HIST_CAP)
+	{
+		size_t newCap = HIST_CAP * 2;
+		if (newCap < HIST_USED + len + 1 + HIST_CHUNK)
+			newCap = HIST_USED + len + 1 + HIST_CHUNK;
+		if (!map_resize(newCap))
+		{
+			flock(HIST_FD, LOCK_UN);
+			return;
+		}
+	}
+
+	memcpy(HIST_MAP + HIST_USED, line, len);
+	HIST_MAP[HIST_USED + len] = '\n';
+	offset_vec_push(&HIST_STARTS, HIST_USED);
+	HIST_USED += len + 1;
+	flock(HIST_FD, LOCK_UN);
+
+	index_entry(HIST_STARTS.size - 1);
+}
+
+
+/*******************************************************************************
+ * Function: history_size()
+ * Description: Returns the number of entries in the history.
+*******************************************************************************/
+int history_size(void)
+{
+	if (!history_enabled())
+		return 0;
+	return HIST_STARTS.size;
+}
+
+
+/*******************************************************************************
+ * Function: history_entry(int id, char *buffer, int bufferSize)
+ * Description: Copies entry id into buffer as a string, truncating it to fit.
+ * 				Returns the number of characters copied, or -1 if there is no
+ * 				such entry.
+*******************************************************************************/
+int history_entry(int id, char *buffer, int bufferSize)
+{
+	if (id < 0 || id >= history_size() || bufferSize <= 0)
+		return -1;
+
+	int len = entry_len(id);
+	if (len > bufferSize - 1)
+		len = bufferSize - 1;
+	memcpy(buffer, HIST_MAP + HIST_STARTS.items[id], len);
+	buffer[len] = '\0';
+	return len;
+}
+
+
+/*******************************************************************************
+ * Function: entry_matches(int id, const char *query, int queryLen, bool isPrefix)
+ * Description: Returns true if entry id starts with query (isPrefix) or
+ * 				contains it anywhere.
+*******************************************************************************/
+static bool entry_matches(int id, const char *query, int queryLen, bool isPrefix)
+{
+	const char *entry = HIST_MAP + HIST_STARTS.items[id];
+	int len = entry_len(id);
+
+	if (isPrefix)
+		return len >= queryLen && memcmp(entry, query, queryLen) == 0;
+	return memmem(entry, len, query, queryLen) != NULL;
+}
+
+
+/*******************************************************************************
+ * Function: first_at_or_after(DynArr *postings, int id)
+ * Description: Binary searches a posting list for the position of the first
+ * 				entry id at or after id.
+*******************************************************************************/
+static int first_at_or_after(DynArr *postings, int id)
+{
+	int low = 0;
+	int high = sizeDynArr(postings);
+	while (low < high)
+	{
+		int mid = (low + high) / 2;
+		if (getDynArr(postings, mid) < id)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+
+/*******************************************************************************
+ * Function: search_trigrams(const char *query, int queryLen, int before, bool isPrefix)
+ * Description: Returns the newest entry older than before that matches a query
+ * 				of at least three characters, or -1. Every trigram of the query
+ * 				must appear in a match, so only the shortest posting list among
+ * 				them has to be walked.
+*******************************************************************************/
+static int search_trigrams(const char *query, int queryLen, int before, bool isPrefix)
+{
+	// Pick the rarest trigram in the query
+	DynArr *postings = NULL;
+	for (int i = 0; i + GRAM <= queryLen; i++)
+	{
+		DynArr *list = HIST_INDEX[gram_bucket(query + i)];
+		if (list == NULL)
+			return -1; // No entry has this trigram
+		if (postings == NULL || sizeDynArr(list) < sizeDynArr(postings))
+			postings = list;
+	}
+
+	// Verify candidates newest to oldest
+	for (int i = first_at_or_after(postings, before) - 1; i >= 0; i--)
+	{
+		int id = getDynArr(postings, i);
+		if (entry_matches(id, query, queryLen, isPrefix))
+			return id;
+	}
+	return -1;
+}
+
+
+/*******************************************************************************
+ * Function: search_pair(const char *query, int before, bool isPrefix)
+ * Description: Returns the newest entry older than before that matches a two
+ * 				character query, or -1. Entries are indexed together with their
+ * 				newline, so every occurrence of the pair starts some indexed
+ * 				trigram; the posting lists of all those trigrams are merged
+ * 				newest-first.
+*******************************************************************************/
+static int search_pair(const char *query, int before, bool isPrefix)
+{
+	DynArr *lists[256];
+	int heads[256]; // Number of unvisited postings left in each list
+	int numLists = 0;
+
+	char gram[GRAM] = {query[0], query[1], 0};
+	for (int c = 1; c < 256; c++)
+	{
+		gram[2] = c;
+		DynArr *list = HIST_INDEX[gram_bucket(gram)];
+		if (list == NULL)
+			continue;
+
+		// Several trigrams may hash to the same bucket
+		bool seen = false;
+		for (int i = 0; i < numLists && !seen; i++)
+			seen = (lists[i] == list);
+		if (seen)
+			continue;
+
+		lists[numLists] = list;
+		heads[numLists] = first_at_or_after(list, before);
+		numLists++;
+	}
+
+	while (1)
+	{
+		// Newest candidate across all lists
+		int id = -1;
+		for (int i = 0; i < numLists; i++)
+		{
+			if (heads[i] > 0 && getDynArr(lists[i], heads[i]-1) > id)
+				id = getDynArr(lists[i], heads[i]-1);
+		}
+		if (id == -1)
+			return -1;
+
+		if (entry_matches(id, query, 2, isPrefix))
+			return id;
+
+		// Step every list past this candidate
+		for (int i = 0; i < numLists; i++)
+		{
+			if (heads[i] > 0 && getDynArr(lists[i], heads[i]-1) == id)
+				heads[i]--;
+		}
+	}
+}
+
+
+/*******************************************************************************
+ * Function: search(const char *query, int before, bool isPrefix)
+ * Description: Returns the newest entry older than before that matches query,
+ * 				or -1. A single character is looked up in the list of entries
+ * 				that start with it or that hold it.
+*******************************************************************************/
+static int search(const char *query, int before, bool isPrefix)
+{
+	int queryLen = strlen(query);
+	if (before > history_size())
+		before = history_size();
+
+	if (queryLen >= GRAM)
+		return search_trigrams(query, queryLen, before, isPrefix);
+	if (queryLen == 2)
+		return search_pair(query, before, isPrefix);
+
+	unsigned char byte = query[0];
+	DynArr *postings = isPrefix ? HIST_FIRST_BYTE[byte] : HIST_HAS_BYTE[byte];
+	if (postings == NULL)
+		return -1;
+	int i = first_at_or_after(postings, before);
+	return (i > 0) ? getDynArr(postings, i - 1) : -1;
+}
+
+
+/*******************************************************************************
+ * Function: history_search(const char *needle, int before)
+ * Description: Returns the id of the newest entry older than before that
+ * 				contains needle, or -1 if there is none. Pass history_size() as
+ * 				before to search the whole history.
+*******************************************************************************/
+int history_search(const char *needle, int before)
+{
+	if (!history_enabled() || needle[0] == '\0')
+		return -1;
+	return search(needle, before, false);
+}
+
+
+/*******************************************************************************
+ * Function: history_find_prefix(const char *prefix)
+ * Description: Returns the id of the newest entry that starts with prefix, or
+ * 				-1 if there is none. Used for !prefix recall.
+*******************************************************************************/
+int history_find_prefix(const char *prefix)
+{
+	if (!history_enabled() || prefix[0] == '\0')
+		return -1;
+	return search(prefix, history_size(), true);
+}
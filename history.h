@@ -0,0 +1,24 @@
+/*******************************************************************************
+ * File: history.h
+ * Description: Persistent command history for smallsh. Entries are appended to
+ * 				an mmap'd log file (one command per line) and indexed in memory
+ * 				by trigram so reverse searches and !prefix recall do not have to
+ * 				scan the whole log.
+*******************************************************************************/
+#ifndef HISTORY_INCLUDED
+#define HISTORY_INCLUDED 1
+
+#include <stdbool.h>
+
+bool history_init(const char *path);
+void history_close(void);
+bool history_enabled(void);
+
+void history_add(const char *line);
+int history_size(void);
+int history_entry(int id, char *buffer, int bufferSize);
+
+int history_search(const char *needle, int before);
+int history_find_prefix(const char *prefix);
+
+#endif
@@ -0,0 +1,380 @@
+/*******************************************************************************
+ * File: ioring.c
+ * Description: Implements the I/O engine described in ioring.h on a raw
+ * 				io_uring, set up with the syscalls themselves so no library is
+ * 				needed. The ring belongs to the shell, so nothing that runs in
+ * 				a forked child may use it; such code makes the plain syscalls.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "output.h"
+#include "envstore.h"
+#include "ioring.h"
+
+// Constants
+#define RING_ENTRIES 64
+
+// Struct for the shared rings; tail counts the SQEs written so far
+struct Ring
+{
+	int fd;
+	unsigned entries;
+	unsigned tail;
+	unsigned submitted;
+	unsigned *sqHead;
+	unsigned *sqTail;
+	unsigned *sqMask;
+	unsigned *sqArray;
+	unsigned *cqHead;
+	unsigned *cqTail;
+	unsigned *cqMask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+};
+
+// Globals
+static struct Ring RING = {-1};
+static bool RING_FAILED = false; // Set up was tried and did not work
+static uint32_t RING_BATCH = 0; // Sequence number of the last batch of opens
+
+
+/*******************************************************************************
+ * Function: ring_supported(int fd)
+ * Description: Returns true if the kernel's ring can open and close files.
+*******************************************************************************/
+static bool ring_supported(int fd)
+{
+	size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+	struct io_uring_probe *probe = calloc(1, size);
+	bool supported = probe != NULL &&
+		syscall(SYS_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+		probe->last_op >= IORING_OP_CLOSE &&
+		(probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) &&
+		(probe->ops[IORING_OP_CLOSE].flags & IO_URING_OP_SUPPORTED);
+	free(probe);
+	return supported;
+}
+
+
+/*******************************************************************************
+ * Function: ring_setup()
+ * Description: Creates the ring and maps its queues. Returns false after
+ * 				displaying why if io_uring cannot be used.
+*******************************************************************************/
+static bool ring_setup(void)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	int fd = syscall(SYS_io_uring_setup, RING_ENTRIES, &params);
+	if (fd == -1)
+	{
+		out_printf("io_uring: %s; using plain syscalls\n", strerror(errno));
+		return false;
+	}
+	if (!ring_supported(fd))
+	{
+		out_printf("io_uring: kernel lacks open and close; using plain syscalls\n");
+		close(fd);
+		return false;
+	}
+
+	// Kernels with a single mapping for both rings need the larger size
+	size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single && cqSize > sqSize)
+		sqSize = cqSize;
+	size_t sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	char *sq = mmap(NULL, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+		IORING_OFF_SQ_RING);
+	char *cq = single ? sq : mmap(NULL, cqSize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+	void *sqes = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+		IORING_OFF_SQES);
+	if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED)
+	{
+		out_printf("io_uring: cannot map the ring; using plain syscalls\n");
+		if (sq != MAP_FAILED)
+			munmap(sq, sqSize);
+		if (!single && cq != MAP_FAILED)
+			munmap(cq, cqSize);
+		if (sqes != MAP_FAILED)
+			munmap(sqes, sqesSize);
+		close(fd);
+		return false;
+	}
+
+	RING.fd = fd;
+	RING.entries = params.sq_entries;
+	RING.sqHead = (unsigned *)(sq + params.sq_off.head);
+	RING.sqTail = (unsigned *)(sq + params.sq_off.tail);
+	RING.sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+	RING.sqArray = (unsigned *)(sq + params.sq_off.array);
+	RING.cqHead = (unsigned *)(cq + params.cq_off.head);
+	RING.cqTail = (unsigned *)(cq + params.cq_off.tail);
+	RING.cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+	RING.sqes = sqes;
+	RING.cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+	RING.tail = *RING.sqTail;
+	RING.submitted = RING.tail;
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: ring_usable()
+ * Description: Returns true if the engine is on and the ring works, setting
+ * 				it up on first use.
+*******************************************************************************/
+static bool ring_usable(void)
+{
+	if (RING.fd != -1)
+		return true;
+
+	const char *setting = env_get("SMALLSH_IO_URING");
+	if (RING_FAILED || setting == NULL || strcmp(setting, "1") != 0)
+		return false;
+	if (!ring_setup())
+	{
+		RING_FAILED = true;
+		return false;
+	}
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: ring_rollback()
+ * Description: Takes back the SQEs the kernel has not consumed, so they are
+ * 				not sent with a later submission. Queued closes are done with
+ * 				close() instead; the opens are reported failed by the caller.
+*******************************************************************************/
+static void ring_rollback(void)
+{
+	int error = errno;
+	for (unsigned i = RING.submitted; i != RING.tail; i++)
+	{
+		struct io_uring_sqe *sqe = &RING.sqes[RING.sqArray[i & *RING.sqMask]];
+		if (sqe->opcode == IORING_OP_CLOSE)
+			close(sqe->fd);
+	}
+	RING.tail = RING.submitted;
+	__atomic_store_n(RING.sqTail, RING.tail, __ATOMIC_RELEASE);
+	errno = error;
+}
+
+
+/*******************************************************************************
+ * Function: ring_enter(unsigned waitFor)
+ * Description: Submits the SQEs written since the last call and waits for
+ * 				waitFor completions. Returns -1 on an error other than EINTR,
+ * 				after taking back the SQEs that were not submitted.
+*******************************************************************************/
+static int ring_enter(unsigned waitFor)
+{
+	__atomic_store_n(RING.sqTail, RING.tail, __ATOMIC_RELEASE);
+	int result;
+	do
+	{
+		result = syscall(SYS_io_uring_enter, RING.fd, RING.tail - RING.submitted, waitFor,
+			(waitFor > 0) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while (result == -1 && errno == EINTR);
+	if (result > 0)
+		RING.submitted += result;
+	if (result == -1)
+		ring_rollback();
+	return result;
+}
+
+
+/*******************************************************************************
+ * Function: ring_reserve(unsigned count)
+ * Description: Makes room for count SQEs, submitting queued closes if needed,
+ * 				so a linked batch is never split across submissions.
+*******************************************************************************/
+static bool ring_reserve(unsigned count)
+{
+	if (RING.tail - __atomic_load_n(RING.sqHead, __ATOMIC_ACQUIRE) + count > RING.entries)
+		ring_enter(0);
+	return RING.tail - __atomic_load_n(RING.sqHead, __ATOMIC_ACQUIRE) + count <= RING.entries;
+}
+
+
+/*******************************************************************************
+ * Function: ring_sqe()
+ * Description: Returns the next SQE, cleared, after ring_reserve() made room.
+*******************************************************************************/
+static struct io_uring_sqe *ring_sqe(void)
+{
+	unsigned index = RING.tail & *RING.sqMask;
+	struct io_uring_sqe *sqe = &RING.sqes[index];
+	memset(sqe, 0, sizeof(*sqe));
+	RING.sqArray[index] = index;
+	RING.tail++;
+	return sqe;
+}
+
+
+/*******************************************************************************
+ * Function: ring_reap(int results[], int count, int wanted, uint32_t batch)
+ * Description: Takes completions off the ring. Opens from batch tagged 1 to
+ * 				count store their result in results; closes are tagged 0 and
+ * 				dropped. An open from an earlier batch, which gave up on it
+ * 				when the ring failed, is closed. Waits until wanted tagged ones
+ * 				have come in, marking the rest failed if the ring stops working.
+*******************************************************************************/
+static void ring_reap(int results[], int count, int wanted, uint32_t batch)
+{
+	int seen = 0;
+	while (1)
+	{
+		unsigned head = *RING.cqHead;
+		unsigned tail = __atomic_load_n(RING.cqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++)
+		{
+			struct io_uring_cqe *cqe = &RING.cqes[head & *RING.cqMask];
+			uint32_t tag = cqe->user_data & UINT32_MAX;
+			if (batch != 0 && cqe->user_data >> 32 == batch && tag > 0 &&
+				tag <= (uint32_t)count)
+			{
+				results[tag - 1] = cqe->res;
+				seen++;
+			}
+			else if (cqe->user_data != 0 && cqe->res >= 0)
+			{
+				close(cqe->res);
+			}
+		}
+		__atomic_store_n(RING.cqHead, head, __ATOMIC_RELEASE);
+		if (seen >= wanted)
+			return;
+
+		if (ring_enter(1) == -1)
+		{
+			int error = errno;
+			for (int i = 0; i < count; i++)
+			{
+				if (results[i] == INT32_MIN)
+					results[i] = -error;
+			}
+			return;
+		}
+	}
+}
+
+
+/*******************************************************************************
+ * Function: ioring_open(struct IoringOpen files[], int count, bool stopAtError)
+ * Description: Takes in up to IORING_BATCH_MAX files and opens each one that
+ * 				has a path, setting its fd or error. With stopAtError the files
+ * 				are opened in order and those after a failure are not opened,
+ * 				so an output file is not created when its input is missing.
+*******************************************************************************/
+void ioring_open(struct IoringOpen files[], int count, bool stopAtError)
+{
+	if (count > IORING_BATCH_MAX)
+		count = IORING_BATCH_MAX;
+	bool failed = false;
+
+	if (!ring_usable() || !ring_reserve(count))
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (files[i].path == NULL)
+			{
+				files[i].fd = -1;
+				files[i].error = 0;
+				continue;
+			}
+			files[i].fd = failed ? -1 : open(files[i].path, files[i].flags, files[i].mode);
+			files[i].error = failed ? ECANCELED : (files[i].fd == -1) ? errno : 0;
+			failed = stopAtError && files[i].fd == -1;
+		}
+		return;
+	}
+
+	// One linked chain when stopping at errors, so a failure cancels the rest.
+	// The batch number tells its completions from those of a failed batch
+	if (++RING_BATCH == 0)
+		RING_BATCH = 1;
+	int results[IORING_BATCH_MAX];
+	int submitted = 0;
+	struct io_uring_sqe *last = NULL;
+	for (int i = 0; i < count; i++)
+	{
+		results[i] = INT32_MIN;
+		if (files[i].path == NULL)
+			continue;
+		if (stopAtError && last != NULL)
+			last->flags |= IOSQE_IO_LINK;
+		last = ring_sqe();
+		last->opcode = IORING_OP_OPENAT;
+		last->fd = AT_FDCWD;
+		last->addr = (uintptr_t)files[i].path;
+		last->len = files[i].mode;
+		last->open_flags = files[i].flags;
+		last->user_data = ((uint64_t)RING_BATCH << 32) | (uint64_t)(i + 1);
+		submitted++;
+	}
+
+	// Submits the batch, with any queued closes, and waits in one call
+	if (submitted > 0 && ring_enter(submitted) != -1)
+		ring_reap(results, count, submitted, RING_BATCH);
+	for (int i = 0; i < count; i++)
+	{
+		bool opened = files[i].path != NULL && results[i] >= 0;
+		files[i].fd = opened ? results[i] : -1;
+		files[i].error = (files[i].path == NULL || opened) ? 0 :
+			(results[i] == INT32_MIN) ? EIO : -results[i];
+	}
+}
+
+
+/*******************************************************************************
+ * Function: ioring_close(int fd)
+ * Description: Closes fd. With the engine on the close is queued and goes out
+ * 				with the next submission or ioring_flush().
+*******************************************************************************/
+void ioring_close(int fd)
+{
+	if (fd < 0)
+		return;
+	if (!ring_usable() || !ring_reserve(1))
+	{
+		close(fd);
+		return;
+	}
+
+	struct io_uring_sqe *sqe = ring_sqe();
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->fd = fd;
+	sqe->user_data = 0;
+}
+
+
+/*******************************************************************************
+ * Function: ioring_flush()
+ * Description: Submits any queued closes without waiting for them, and drops
+ * 				the completions of earlier ones.
+*******************************************************************************/
+void ioring_flush(void)
+{
+	if (RING.fd == -1)
+		return;
+	if (RING.tail != RING.submitted)
+		ring_enter(0);
+	ring_reap(NULL, 0, 0, 0);
+}
@@ -0,0 +1,35 @@
+/*******************************************************************************
+ * File: ioring.h
+ * Description: Optional io_uring engine for the file opens and closes the
+ * 				shell does itself: the cat builtin and the redirections of
+ * 				builtins such as cp and memo. With SMALLSH_IO_URING=1 a batch of
+ * 				opens is submitted with one io_uring_enter() and closes are
+ * 				queued to go out with the next submission, or ioring_flush().
+ * 				Without it, or when io_uring cannot be used, the same calls make
+ * 				the plain syscalls one at a time. Only the shell may call these;
+ * 				a forked child must not touch the ring it shares.
+*******************************************************************************/
+#ifndef IORING_INCLUDED
+#define IORING_INCLUDED 1
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+// Constants
+#define IORING_BATCH_MAX 32 // Most files one ioring_open() takes
+
+// Struct for a file to open in a batch
+struct IoringOpen
+{
+	const char *path; // NULL to skip the entry
+	int flags;
+	mode_t mode;
+	int fd; // Set to the descriptor, or -1 with error set
+	int error; // ECANCELED when skipped after an earlier failure
+};
+
+void ioring_open(struct IoringOpen files[], int count, bool stopAtError);
+void ioring_close(int fd);
+void ioring_flush(void);
+
+#endif
@@ -0,0 +1,358 @@
+/*******************************************************************************
+ * File: jobstate.c
+ * Description: Implements the job table described in jobstate.h. Shells
+ * 				sharing the file never lock it: a slot is claimed by swapping
+ * 				its owner from 0, or from a shell that has gone, to this
+ * 				shell's pid, and only the owner writes the rest of it. A job
+ * 				is only adopted if a pidfd can be opened for it and its start
+ * 				time still matches, so a reused pid is never mistaken for it.
+ * 				Does nothing unless SMALLSH_JOB_STATE is set.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include "output.h"
+#include "envstore.h"
+#include "statuspage.h"
+#include "vec.h"
+#include "jobstate.h"
+
+// An adopted job and the pidfd that shows when it exits
+struct Adopted
+{
+	pid_t pid;
+	int pidfd;
+};
+
+VEC_DECLARE(AdoptedVec, adopted_vec, struct Adopted)
+
+// Globals
+static struct JobStateFile *STATE = NULL;
+static pid_t STATE_OWNER = 0; // Forked children never write the file
+static uint64_t OWNER_START = 0;
+static AdoptedVec ADOPTED = {NULL, 0, 0};
+
+
+/*******************************************************************************
+ * Function: process_start(pid_t pid)
+ * Description: Returns when pid started, in clock ticks since boot, from
+ * 				field 22 of /proc/PID/stat, or 0 if it is not running.
+*******************************************************************************/
+static uint64_t process_start(pid_t pid)
+{
+	char path[64], text[1024];
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return 0;
+	ssize_t len = read(fd, text, sizeof(text) - 1);
+	close(fd);
+	if (len <= 0)
+		return 0;
+	text[len] = '\0';
+
+	// The command name can hold spaces, so count fields after its ')'
+	char *field = strrchr(text, ')');
+	for (int i = 2; field != NULL && i < 22; i++)
+		field = strchr(field + 1, ' ');
+	return (field != NULL) ? strtoull(field + 1, NULL, 10) : 0;
+}
+
+
+/*******************************************************************************
+ * Function: open_pidfd(pid_t pid)
+ * Description: Returns a pidfd for pid, close on exec, or -1.
+*******************************************************************************/
+static int open_pidfd(pid_t pid)
+{
+	int pidfd = -1;
+#ifdef SYS_pidfd_open
+	pidfd = syscall(SYS_pidfd_open, pid, 0);
+	if (pidfd != -1)
+		fcntl(pidfd, F_SETFD, FD_CLOEXEC);
+#endif
+	return pidfd;
+}
+
+
+/*******************************************************************************
+ * Function: owner_alive(const struct JobRecord *record, pid_t owner)
+ * Description: Returns true if the shell that owns a slot is still running.
+*******************************************************************************/
+static bool owner_alive(const struct JobRecord *record, pid_t owner)
+{
+	if (kill(owner, 0) == -1 && errno == ESRCH)
+		return false;
+
+	// A different process that got the shell's pid
+	uint64_t ownerStart = __atomic_load_n(&record->ownerStart, __ATOMIC_ACQUIRE);
+	return ownerStart == 0 || process_start(owner) == ownerStart;
+}
+
+
+/*******************************************************************************
+ * Function: release(struct JobRecord *record)
+ * Description: Frees a slot this shell owns.
+*******************************************************************************/
+static void release(struct JobRecord *record)
+{
+	record->pid = 0;
+	__atomic_store_n(&record->owner, 0, __ATOMIC_RELEASE);
+}
+
+
+/*******************************************************************************
+ * Function: adopt(struct JobRecord *record, PidVec *cpids)
+ * Description: Takes over a slot whose shell has gone. If its job is still
+ * 				running it is added to the background jobs, otherwise the slot
+ * 				is freed.
+*******************************************************************************/
+static void adopt(struct JobRecord *record, PidVec *cpids)
+{
+	pid_t pid = record->pid;
+	int pidfd = (pid > 0) ? open_pidfd(pid) : -1;
+	if (pidfd == -1 || process_start(pid) != record->start)
+	{
+		if (pidfd != -1)
+			close(pidfd);
+		release(record);
+		return;
+	}
+
+	record->command[JOBSTATE_COMMAND_LEN - 1] = '\0';
+	struct Adopted adopted = {pid, pidfd};
+	adopted_vec_push(&ADOPTED, adopted);
+	pid_vec_push(cpids, pid);
+
+	char *command[2] = {record->command, NULL};
+	status_page_add(pid, command, true);
+	out_printf("adopted background pid %d: %s\n", pid, record->command);
+}
+
+
+/*******************************************************************************
+ * Function: jobstate_open(PidVec *cpids)
+ * Description: Takes in the array of background child pids. If
+ * 				SMALLSH_JOB_STATE is set, maps the job file, creating it if
+ * 				needed, adopts the surviving jobs of shells that have gone into
+ * 				cpids and makes the shell a child subreaper. A file that cannot
+ * 				be used is reported and then skipped.
+*******************************************************************************/
+void jobstate_open(PidVec *cpids)
+{
+	const char *setting = env_get("SMALLSH_JOB_STATE");
+	if (setting == NULL || setting[0] == '\0')
+		return;
+
+	char path[4096];
+	const char *runtime = env_get("XDG_RUNTIME_DIR");
+	if (strcmp(setting, "1") != 0)
+		snprintf(path, sizeof(path), "%s", setting);
+	else if (runtime != NULL && runtime[0] != '\0')
+		snprintf(path, sizeof(path), "%s/smallsh-jobs", runtime);
+	else
+		snprintf(path, sizeof(path), "/tmp/smallsh-jobs.%d", (int)getuid());
+
+	// Never truncated; another shell may be using it
+	int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	struct stat info;
+	if (fd == -1 || fstat(fd, &info) == -1 ||
+		(info.st_size < (off_t)sizeof(struct JobStateFile) &&
+		ftruncate(fd, sizeof(struct JobStateFile)) == -1))
+	{
+		out_printf("cannot open job state %s\n", path);
+		if (fd != -1)
+			close(fd);
+		return;
+	}
+	void *map = mmap(NULL, sizeof(struct JobStateFile), PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		out_printf("cannot open job state %s\n", path);
+		return;
+	}
+
+	// A new file is all zeros; anything else must be this layout
+	struct JobStateFile *state = map;
+	if (state->magic == 0)
+	{
+		state->version = JOBSTATE_VERSION;
+		state->size = sizeof(struct JobStateFile);
+		__atomic_store_n(&state->magic, JOBSTATE_MAGIC, __ATOMIC_RELEASE);
+	}
+	else if (state->magic != JOBSTATE_MAGIC || state->version != JOBSTATE_VERSION ||
+		state->size != sizeof(struct JobStateFile))
+	{
+		out_printf("job state %s has an unknown format\n", path);
+		munmap(map, sizeof(struct JobStateFile));
+		return;
+	}
+	STATE = state;
+	STATE_OWNER = getpid();
+	OWNER_START = process_start(STATE_OWNER);
+	prctl(PR_SET_CHILD_SUBREAPER, 1);
+
+	// A slot owned by this pid was left by this process before an exec
+	for (int i = 0; i < JOBSTATE_MAX_JOBS; i++)
+	{
+		struct JobRecord *record = &STATE->jobs[i];
+		int32_t owner = __atomic_load_n(&record->owner, __ATOMIC_ACQUIRE);
+		if (owner == 0 || (owner != STATE_OWNER && owner_alive(record, owner)))
+			continue;
+		if (!__atomic_compare_exchange_n(&record->owner, &owner, STATE_OWNER, false,
+			__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			continue;
+		__atomic_store_n(&record->ownerStart, OWNER_START, __ATOMIC_RELEASE);
+		adopt(record, cpids);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: jobstate_add(pid_t pid, char *arguments[])
+ * Description: Records a background job that was just started, with its args
+ * 				joined by spaces as the command. A full table leaves the job
+ * 				out.
+*******************************************************************************/
+void jobstate_add(pid_t pid, char *arguments[])
+{
+	if (STATE == NULL || getpid() != STATE_OWNER)
+		return;
+
+	for (int i = 0; i < JOBSTATE_MAX_JOBS; i++)
+	{
+		struct JobRecord *record = &STATE->jobs[i];
+		int32_t expected = 0;
+		if (!__atomic_compare_exchange_n(&record->owner, &expected, STATE_OWNER, false,
+			__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			continue;
+
+		record->ownerStart = OWNER_START;
+		record->start = process_start(pid);
+		size_t used = 0;
+		record->command[0] = '\0';
+		for (int j = 0; arguments[j] != NULL && used < JOBSTATE_COMMAND_LEN - 1; j++)
+		{
+			used += snprintf(record->command + used, JOBSTATE_COMMAND_LEN - used, "%s%s",
+				(j > 0) ? " " : "", arguments[j]);
+		}
+		__atomic_store_n(&record->pid, pid, __ATOMIC_RELEASE);
+		return;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: jobstate_remove(pid_t pid)
+ * Description: Forgets a background job that has been reaped or has gone.
+*******************************************************************************/
+void jobstate_remove(pid_t pid)
+{
+	if (STATE == NULL || getpid() != STATE_OWNER)
+		return;
+
+	for (int i = 0; i < ADOPTED.size; i++)
+	{
+		if (ADOPTED.items[i].pid == pid)
+		{
+			close(ADOPTED.items[i].pidfd);
+			adopted_vec_swap_remove(&ADOPTED, i);
+			break;
+		}
+	}
+	for (int i = 0; i < JOBSTATE_MAX_JOBS; i++)
+	{
+		struct JobRecord *record = &STATE->jobs[i];
+		if (record->owner == STATE_OWNER && record->pid == pid)
+		{
+			release(record);
+			return;
+		}
+	}
+}
+
+
+/*******************************************************************************
+ * Function: jobstate_gone(pid_t pid)
+ * Description: Takes in a background job that waiting says is not a child.
+ * 				Returns true if it is an adopted job that has exited, whose
+ * 				exit status cannot be known.
+*******************************************************************************/
+bool jobstate_gone(pid_t pid)
+{
+	for (int i = 0; i < ADOPTED.size; i++)
+	{
+		if (ADOPTED.items[i].pid == pid)
+		{
+			struct pollfd exited = {ADOPTED.items[i].pidfd, POLLIN, 0};
+			return poll(&exited, 1, 0) == 1;
+		}
+	}
+	return false;
+}
+
+
+/*******************************************************************************
+ * Function: jobstate_reap_strays(const PidVec *cpids)
+ * Description: Takes in the array of background child pids. Reaps the
+ * 				processes reparented to the shell as their subreaper, leaving
+ * 				the jobs in cpids for check_for_background_complete().
+*******************************************************************************/
+void jobstate_reap_strays(const PidVec *cpids)
+{
+	if (STATE == NULL)
+		return;
+
+	while (1)
+	{
+		// Look without reaping, so a job's exit is left for its report
+		siginfo_t info;
+		info.si_pid = 0;
+		if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT) == -1 || info.si_pid == 0)
+			return;
+		for (int i = 0; i < cpids->size; i++)
+		{
+			if (cpids->items[i] == info.si_pid)
+				return;
+		}
+		waitpid(info.si_pid, NULL, 0);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: jobstate_close()
+ * Description: Frees every slot this shell owns. Used by exit once the
+ * 				background jobs have been shut down.
+*******************************************************************************/
+void jobstate_close(void)
+{
+	if (STATE == NULL || getpid() != STATE_OWNER)
+		return;
+
+	for (int i = 0; i < JOBSTATE_MAX_JOBS; i++)
+	{
+		if (STATE->jobs[i].owner == STATE_OWNER)
+			release(&STATE->jobs[i]);
+	}
+	for (int i = 0; i < ADOPTED.size; i++)
+		close(ADOPTED.items[i].pidfd);
+	adopted_vec_free(&ADOPTED);
+}
@@ -0,0 +1,59 @@
+/*******************************************************************************
+ * File: jobstate.h
+ * Description: Job table that survives a restart of the shell. When
+ * 				SMALLSH_JOB_STATE is set, each background job's pid, start
+ * 				time and command are kept in a small mmap'd file:
+ * 				SMALLSH_JOB_STATE=1 uses $XDG_RUNTIME_DIR/smallsh-jobs, or
+ * 				/tmp/smallsh-jobs.<uid>; any other value is taken as the path.
+ * 				A shell started with the same file adopts the jobs whose
+ * 				shell has gone and that are still running, and reports them
+ * 				as done like its own jobs. The shell also becomes a child
+ * 				subreaper, so processes a job leaves behind are reparented to
+ * 				it rather than to init, and jobs that are its children (after
+ * 				the shell was re-executed in place) are reaped with their exit
+ * 				status. Other adopted jobs are watched through a pidfd, and
+ * 				their exit status cannot be known. exit shuts the jobs down
+ * 				and clears them from the file.
+*******************************************************************************/
+#ifndef JOBSTATE_INCLUDED
+#define JOBSTATE_INCLUDED 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "vec.h"
+
+// Constants
+#define JOBSTATE_MAGIC 0x4a485353 // "SSHJ"
+#define JOBSTATE_VERSION 1
+#define JOBSTATE_MAX_JOBS 256
+#define JOBSTATE_COMMAND_LEN 128
+
+// A background job; a slot is claimed by atomically setting owner
+struct JobRecord
+{
+	int32_t owner; // The shell's pid, 0 for a free slot
+	int32_t pid; // 0 until the job is filled in
+	uint64_t ownerStart; // Start times from /proc/PID/stat, against pid reuse
+	uint64_t start;
+	char command[JOBSTATE_COMMAND_LEN];
+};
+
+// The whole file, in native byte order
+struct JobStateFile
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; // sizeof(struct JobStateFile)
+	uint32_t reserved;
+	struct JobRecord jobs[JOBSTATE_MAX_JOBS];
+};
+
+void jobstate_open(PidVec *cpids);
+void jobstate_add(pid_t pid, char *arguments[]);
+void jobstate_remove(pid_t pid);
+bool jobstate_gone(pid_t pid);
+void jobstate_reap_strays(const PidVec *cpids);
+void jobstate_close(void);
+
+#endif
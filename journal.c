@@ -0,0 +1,369 @@
+/*******************************************************************************
+ * File: journal.c
+ * Description: Implements the execution journal described in journal.h. A
+ * 				job's args, cwd and start times are noted when it is spawned;
+ * 				when it is reaped the whole record is formatted and copied
+ * 				into an in-memory queue. A writer thread swaps the queue for
+ * 				an empty one and writes it to the file with one write(), so
+ * 				the only cost on the shell's side is a short locked copy.
+ * 				Does nothing unless SMALLSH_JOURNAL is set.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "output.h"
+#include "envstore.h"
+#include "journal.h"
+#include "util.h"
+
+// Constants
+#define QUEUE_SIZE (256 * 1024) // Bytes of records waiting to be written
+#define RECORD_SIZE 512 // Starting size of a record's buffer
+
+// A job that has been spawned but not reaped
+struct JournalStart
+{
+	pid_t pid;
+	bool isBackground;
+	int64_t startNs; // CLOCK_REALTIME
+	int64_t startMonoNs; // CLOCK_MONOTONIC, for the elapsed time
+	uint64_t hash;
+	char *cwd; // Already escaped for JSON
+	char *cmd; // Already escaped for JSON
+	bool hasTree;
+	struct CgroupUsage tree; // From the job's cgroup
+};
+
+// A growable string for building a record
+struct Text
+{
+	char *data;
+	size_t len;
+	size_t cap;
+};
+
+// Globals
+static int JOURNAL_FD = -1;
+static pid_t JOURNAL_OWNER = 0; // Only the shell itself stops the writer
+static pthread_t WRITER;
+static pthread_mutex_t QUEUE_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t QUEUE_READY = PTHREAD_COND_INITIALIZER;
+static char *QUEUE = NULL; // Filled by the shell
+static char *SPARE = NULL; // Swapped in by the writer while it writes QUEUE
+static size_t QUEUE_LEN = 0;
+static bool STOPPING = false;
+static unsigned long DROPPED = 0; // Records lost to a full queue, not yet reported
+static struct JournalStart *STARTS = NULL;
+static int NUM_STARTS = 0;
+static int CAP_STARTS = 0;
+
+
+/*******************************************************************************
+ * Function: clock_ns(clockid_t clock)
+ * Description: Returns the time on the given clock in nanoseconds.
+*******************************************************************************/
+static int64_t clock_ns(clockid_t clock)
+{
+	struct timespec now;
+	clock_gettime(clock, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/*******************************************************************************
+ * Function: text_printf(struct Text *text, const char *format, ...)
+ * Description: Appends printf-style output to text, growing it as needed.
+*******************************************************************************/
+static void text_printf(struct Text *text, const char *format, ...)
+{
+	va_list args;
+	while (1)
+	{
+		va_start(args, format);
+		int len = vsnprintf(text->data + text->len, text->cap - text->len, format, args);
+		va_end(args);
+		if (len < 0)
+			return;
+		if (text->len + len < text->cap)
+		{
+			text->len += len;
+			return;
+		}
+		text->cap = (text->cap + len) * 2;
+		text->data = realloc(text->data, text->cap);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: escape_json(const char *value)
+ * Description: Returns a malloc'd copy of value escaped for use inside a JSON
+ * 				string.
+*******************************************************************************/
+static char *escape_json(const char *value)
+{
+	// No character takes more than six bytes escaped
+	char *escaped = malloc(strlen(value) * 6 + 1);
+	char *out = escaped;
+	for (const unsigned char *c = (const unsigned char *)value; *c != '\0'; c++)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			*out++ = '\\';
+			*out++ = *c;
+		}
+		else if (*c < 0x20)
+			out += sprintf(out, "\\u%04x", *c);
+		else
+			*out++ = *c;
+	}
+	*out = '\0';
+	return escaped;
+}
+
+
+/*******************************************************************************
+ * Function: writer_main(void *unused)
+ * Description: The writer thread. Waits for records, takes the whole queue and
+ * 				writes it outside the lock. Returns once it is stopping and the
+ * 				queue is empty.
+*******************************************************************************/
+static void *writer_main(void *unused)
+{
+	pthread_mutex_lock(&QUEUE_LOCK);
+	while (1)
+	{
+		while (QUEUE_LEN == 0 && !STOPPING)
+			pthread_cond_wait(&QUEUE_READY, &QUEUE_LOCK);
+		if (QUEUE_LEN == 0)
+			break;
+
+		char *batch = QUEUE;
+		size_t len = QUEUE_LEN;
+		QUEUE = SPARE;
+		QUEUE_LEN = 0;
+		pthread_mutex_unlock(&QUEUE_LOCK);
+
+		write_all(JOURNAL_FD, batch, len);
+
+		pthread_mutex_lock(&QUEUE_LOCK);
+		SPARE = batch;
+	}
+	pthread_mutex_unlock(&QUEUE_LOCK);
+	return NULL;
+}
+
+
+/*******************************************************************************
+ * Function: journal_close()
+ * Description: Stops the writer once everything queued has been written.
+ * 				Registered with atexit() and skipped in forked children, which
+ * 				do not have the thread.
+*******************************************************************************/
+static void journal_close(void)
+{
+	if (JOURNAL_FD == -1 || getpid() != JOURNAL_OWNER)
+		return;
+
+	pthread_mutex_lock(&QUEUE_LOCK);
+	STOPPING = true;
+	pthread_cond_signal(&QUEUE_READY);
+	pthread_mutex_unlock(&QUEUE_LOCK);
+	pthread_join(WRITER, NULL);
+
+	close(JOURNAL_FD);
+	JOURNAL_FD = -1;
+}
+
+
+/*******************************************************************************
+ * Function: journal_open()
+ * Description: Opens the journal named by SMALLSH_JOURNAL for appending and
+ * 				starts the writer thread. A journal that cannot be opened is
+ * 				reported once and then skipped.
+*******************************************************************************/
+void journal_open(void)
+{
+	const char *path = env_get("SMALLSH_JOURNAL");
+	if (path == NULL || path[0] == '\0')
+		return;
+
+	JOURNAL_FD = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if (JOURNAL_FD == -1)
+	{
+		out_printf("cannot open journal %s\n", path);
+		return;
+	}
+	QUEUE = malloc(QUEUE_SIZE);
+	SPARE = malloc(QUEUE_SIZE);
+
+	// The writer takes no signals, so CTRL-C and CTRL-Z still reach the shell
+	sigset_t all, old;
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	int result = pthread_create(&WRITER, NULL, writer_main, NULL);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	if (result != 0)
+	{
+		out_printf("cannot open journal %s\n", path);
+		close(JOURNAL_FD);
+		JOURNAL_FD = -1;
+		return;
+	}
+	JOURNAL_OWNER = getpid();
+	atexit(journal_close);
+}
+
+
+/*******************************************************************************
+ * Function: journal_start(pid_t pid, char *arguments[], bool isBackground)
+ * Description: Notes a job that was just spawned: its start time, cwd, args
+ * 				and their hash.
+*******************************************************************************/
+void journal_start(pid_t pid, char *arguments[], bool isBackground)
+{
+	if (JOURNAL_FD == -1)
+		return;
+
+	if (NUM_STARTS == CAP_STARTS)
+	{
+		CAP_STARTS = (CAP_STARTS == 0) ? 16 : CAP_STARTS * 2;
+		STARTS = realloc(STARTS, CAP_STARTS * sizeof(struct JournalStart));
+	}
+	struct JournalStart *start = &STARTS[NUM_STARTS++];
+	start->pid = pid;
+	start->isBackground = isBackground;
+	start->hasTree = false;
+	start->startNs = clock_ns(CLOCK_REALTIME);
+	start->startMonoNs = clock_ns(CLOCK_MONOTONIC);
+
+	// FNV-1a over the args, each ending with its null byte
+	struct Text cmd = {malloc(RECORD_SIZE), 0, RECORD_SIZE};
+	cmd.data[0] = '\0';
+	start->hash = 14695981039346656037ull;
+	for (int i = 0; arguments[i] != NULL; i++)
+	{
+		for (const char *c = arguments[i]; ; c++)
+		{
+			start->hash ^= (unsigned char)*c;
+			start->hash *= 1099511628211ull;
+			if (*c == '\0')
+				break;
+		}
+		text_printf(&cmd, "%s%s", (i > 0) ? " " : "", arguments[i]);
+	}
+	start->cmd = escape_json(cmd.data);
+	free(cmd.data);
+
+	char *cwd = getcwd(NULL, 0);
+	start->cwd = escape_json((cwd != NULL) ? cwd : "");
+	free(cwd);
+}
+
+
+/*******************************************************************************
+ * Function: journal_cgroup(pid_t pid, const struct CgroupUsage *usage)
+ * Description: Adds what a job's cgroup used to its record, which is written
+ * 				by journal_end().
+*******************************************************************************/
+void journal_cgroup(pid_t pid, const struct CgroupUsage *usage)
+{
+	for (int i = 0; i < NUM_STARTS; i++)
+	{
+		if (STARTS[i].pid == pid)
+		{
+			STARTS[i].hasTree = true;
+			STARTS[i].tree = *usage;
+			return;
+		}
+	}
+}
+
+
+/*******************************************************************************
+ * Function: journal_end(pid_t pid, int childExitMethod, const struct rusage *usage)
+ * Description: Completes the record for a reaped job and queues it for the
+ * 				writer. Jobs that were not started through journal_start() are
+ * 				ignored.
+*******************************************************************************/
+void journal_end(pid_t pid, int childExitMethod, const struct rusage *usage)
+{
+	if (JOURNAL_FD == -1)
+		return;
+
+	int found = -1;
+	for (int i = 0; i < NUM_STARTS && found == -1; i++)
+	{
+		if (STARTS[i].pid == pid)
+			found = i;
+	}
+	if (found == -1)
+		return;
+	struct JournalStart start = STARTS[found];
+	STARTS[found] = STARTS[--NUM_STARTS];
+
+	struct Text record = {malloc(RECORD_SIZE), 0, RECORD_SIZE};
+	text_printf(&record, "{\"start_ns\":%lld,\"end_ns\":%lld,\"ms\":%.3f,\"pid\":%d,\"bg\":%s,",
+		(long long)start.startNs, (long long)clock_ns(CLOCK_REALTIME),
+		(clock_ns(CLOCK_MONOTONIC) - start.startMonoNs) / 1e6, pid,
+		start.isBackground ? "true" : "false");
+	if (WIFEXITED(childExitMethod))
+		text_printf(&record, "\"exit\":%d,", WEXITSTATUS(childExitMethod));
+	else
+		text_printf(&record, "\"signal\":%d,", WTERMSIG(childExitMethod));
+	text_printf(&record, "\"utime_us\":%lld,\"stime_us\":%lld,\"maxrss_kb\":%ld,"
+		"\"minflt\":%ld,\"majflt\":%ld,\"inblock\":%ld,\"oublock\":%ld,"
+		"\"nvcsw\":%ld,\"nivcsw\":%ld,",
+		(long long)usage->ru_utime.tv_sec * 1000000 + usage->ru_utime.tv_usec,
+		(long long)usage->ru_stime.tv_sec * 1000000 + usage->ru_stime.tv_usec,
+		usage->ru_maxrss, usage->ru_minflt, usage->ru_majflt, usage->ru_inblock,
+		usage->ru_oublock, usage->ru_nvcsw, usage->ru_nivcsw);
+	if (start.hasTree)
+	{
+		const struct CgroupUsage *tree = &start.tree;
+		const char *names[6] = {"cg_usage_us", "cg_user_us", "cg_system_us",
+			"cg_throttled_us", "cg_peak_kb", "cg_oom_kills"};
+		long long values[6] = {tree->usageUs, tree->userUs, tree->systemUs,
+			tree->throttledUs, (tree->memoryPeak == -1) ? -1 : tree->memoryPeak / 1024,
+			tree->oomKills};
+		for (int i = 0; i < 6; i++)
+		{
+			if (values[i] != -1)
+				text_printf(&record, "\"%s\":%lld,", names[i], values[i]);
+		}
+	}
+	if (DROPPED > 0)
+		text_printf(&record, "\"dropped\":%lu,", DROPPED);
+	text_printf(&record, "\"hash\":\"%016llx\",\"cwd\":\"%s\",\"cmd\":\"%s\"}\n",
+		(unsigned long long)start.hash, start.cwd, start.cmd);
+	free(start.cwd);
+	free(start.cmd);
+
+	// Never wait for the writer; a full queue loses the record instead
+	pthread_mutex_lock(&QUEUE_LOCK);
+	if (QUEUE_LEN + record.len <= QUEUE_SIZE)
+	{
+		memcpy(QUEUE + QUEUE_LEN, record.data, record.len);
+		QUEUE_LEN += record.len;
+		DROPPED = 0;
+		pthread_cond_signal(&QUEUE_READY);
+	}
+	else
+	{
+		DROPPED++;
+	}
+	pthread_mutex_unlock(&QUEUE_LOCK);
+	free(record.data);
+}
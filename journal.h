@@ -0,0 +1,42 @@
+/*******************************************************************************
+ * File: journal.h
+ * Description: Execution journal for offline performance analysis. When
+ * 				SMALLSH_JOURNAL names a file, the shell appends one JSON
+ * 				object per line for each command it runs:
+ * 					start_ns, end_ns	CLOCK_REALTIME nanoseconds; a
+ * 										background job ends when the shell
+ * 										reaps it, before the next prompt
+ * 					ms					elapsed (monotonic) milliseconds
+ * 					pid, bg				the job's pid and whether it ran in
+ * 										the background
+ * 					exit or signal		how it ended
+ * 					utime_us, stime_us, maxrss_kb, minflt, majflt, inblock,
+ * 					oublock, nvcsw, nivcsw	its rusage from wait4()
+ * 					cg_usage_us, cg_user_us, cg_system_us, cg_throttled_us,
+ * 					cg_peak_kb, cg_oom_kills	for a job run under limit,
+ * 										from its cgroup, so they cover
+ * 										every process it started; each
+ * 										only where the kernel has it
+ * 					hash				FNV-1a of the args, as 16 hex digits
+ * 					cwd, cmd			where it ran and its args joined by
+ * 										spaces
+ * 				Records are queued in memory and written by a background
+ * 				thread, so the shell never waits on the file. If the queue
+ * 				fills up faster than it can be written, records are dropped
+ * 				and a count of them is added to the next record written.
+ * 				tools/journal_top summarizes a journal.
+*******************************************************************************/
+#ifndef JOURNAL_INCLUDED
+#define JOURNAL_INCLUDED 1
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+#include "cgroup.h"
+
+void journal_open(void);
+void journal_start(pid_t pid, char *arguments[], bool isBackground);
+void journal_cgroup(pid_t pid, const struct CgroupUsage *usage);
+void journal_end(pid_t pid, int childExitMethod, const struct rusage *usage);
+
+#endif
@@ -0,0 +1,549 @@
+/*******************************************************************************
+ * File: lineedit.c
+ * Description: Implements the smallsh line editor. The terminal is put into
+ * 				raw mode only while a line is being read and is restored before
+ * 				the line is returned, so commands always run with the user's
+ * 				normal terminal settings. ISIG is left on so CTRL-Z still
+ * 				reaches the SIGTSTP handler; an interrupted read just redraws
+ * 				the line. Each redraw is built in memory and sent with a single
+ * 				write().
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include "history.h"
+#include "complete.h"
+#include "lineedit.h"
+#include "util.h"
+#include "envstore.h"
+
+// Constants
+#define EDIT_MAX 4096
+#define QUERY_MAX 256
+#define LIST_MAX 100 // Completions shown by a double TAB
+
+// Key codes
+#define CTRL_KEY(k) ((k) & 0x1f)
+#define KEY_TAB 9
+#define KEY_ESC 27
+#define KEY_BACKSPACE 127
+
+// Line being edited
+struct Edit
+{
+	const char *prompt;
+	char buf[EDIT_MAX];
+	int len;
+	int pos; // Cursor position in buf
+	int histPos; // History entry shown, history_size() for the new line
+	char saved[EDIT_MAX]; // New line stashed while browsing history
+};
+
+// Globals
+static int WATCH_FD = -1; // Serviced while waiting for keys
+static void (*WATCH_CALLBACK)(void) = NULL;
+
+
+/*******************************************************************************
+ * Function: line_edit_usable()
+ * Description: Returns true if stdin and stdout are a terminal that can handle
+ * 				the editor's escape sequences.
+*******************************************************************************/
+bool line_edit_usable(void)
+{
+	const char *term = env_get("TERM");
+	if (term == NULL || strcmp(term, "dumb") == 0)
+		return false;
+	return isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+}
+
+
+/*******************************************************************************
+ * Function: line_edit_watch(int fd, void (*callback)(void))
+ * Description: Has the editor call callback whenever fd becomes readable while
+ * 				it is waiting for the user, so the shell can keep servicing
+ * 				events (such as job deadlines) at an idle prompt.
+*******************************************************************************/
+void line_edit_watch(int fd, void (*callback)(void))
+{
+	WATCH_FD = fd;
+	WATCH_CALLBACK = callback;
+}
+
+
+/*******************************************************************************
+ * Function: read_key(char *c)
+ * Description: Reads one byte of input like read() would, servicing the
+ * 				watched fd while waiting. Returns -1 with errno EINTR if a
+ * 				signal arrives.
+*******************************************************************************/
+static ssize_t read_key(char *c)
+{
+	while (WATCH_FD != -1)
+	{
+		struct pollfd fds[2];
+		fds[0].fd = STDIN_FILENO;
+		fds[0].events = POLLIN;
+		fds[1].fd = WATCH_FD;
+		fds[1].events = POLLIN;
+
+		if (poll(fds, 2, -1) == -1)
+			return -1;
+		if (fds[1].revents & POLLIN)
+			WATCH_CALLBACK();
+		if (fds[0].revents)
+			break;
+	}
+	return read(STDIN_FILENO, c, 1);
+}
+
+
+/*******************************************************************************
+ * Function: refresh(struct Edit *e)
+ * Description: Redraws the prompt and line in place and puts the cursor back
+ * 				at e->pos.
+*******************************************************************************/
+static void refresh(struct Edit *e)
+{
+	char out[EDIT_MAX + 128];
+	int n = snprintf(out, sizeof(out), "\r%s%.*s\x1b[K", e->prompt, e->len, e->buf);
+	if (e->pos < e->len && n < (int)sizeof(out))
+		n += snprintf(out + n, sizeof(out) - n, "\x1b[%dD", e->len - e->pos);
+	if (n > (int)sizeof(out) - 1)
+		n = sizeof(out) - 1;
+	write_all(STDOUT_FILENO, out, n);
+}
+
+
+/*******************************************************************************
+ * Function: set_line(struct Edit *e, const char *text)
+ * Description: Replaces the line with text and moves the cursor to its end.
+*******************************************************************************/
+static void set_line(struct Edit *e, const char *text)
+{
+	e->len = strlen(text);
+	if (e->len > EDIT_MAX - 1)
+		e->len = EDIT_MAX - 1;
+	memcpy(e->buf, text, e->len);
+	e->pos = e->len;
+}
+
+
+/*******************************************************************************
+ * Function: browse_history(struct Edit *e, int step)
+ * Description: Moves step entries through history (-1 older, +1 newer). The
+ * 				line being typed is saved when leaving it and restored when
+ * 				browsing back past the newest entry.
+*******************************************************************************/
+static void browse_history(struct Edit *e, int step)
+{
+	int target = e->histPos + step;
+	if (target < 0 || target > history_size())
+		return;
+
+	if (e->histPos == history_size())
+	{
+		memcpy(e->saved, e->buf, e->len);
+		e->saved[e->len] = '\0';
+	}
+
+	if (target == history_size())
+	{
+		set_line(e, e->saved);
+	}
+	else
+	{
+		char entry[EDIT_MAX];
+		history_entry(target, entry, sizeof(entry));
+		set_line(e, entry);
+	}
+	e->histPos = target;
+}
+
+
+/*******************************************************************************
+ * Function: draw_search(const char *query, const char *found, bool failed)
+ * Description: Draws the reverse search prompt in place of the line.
+*******************************************************************************/
+static void draw_search(const char *query, const char *found, bool failed)
+{
+	char out[EDIT_MAX + QUERY_MAX + 64];
+	int n = snprintf(out, sizeof(out), "\r(%sreverse-i-search)`%s': %s\x1b[K",
+		failed ? "failed " : "", query, found);
+	if (n > (int)sizeof(out) - 1)
+		n = sizeof(out) - 1;
+	write_all(STDOUT_FILENO, out, n);
+}
+
+
+/*******************************************************************************
+ * Function: reverse_search(struct Edit *e)
+ * Description: Runs an incremental CTRL-R search. Typing narrows the query,
+ * 				CTRL-R again moves to the next older match, CTRL-G or ESC gives
+ * 				up and keeps the original line. Enter accepts the match and
+ * 				returns 1 to submit it; any other key accepts the match for
+ * 				editing and returns 0. Returns -1 if input ends.
+*******************************************************************************/
+static int reverse_search(struct Edit *e)
+{
+	char query[QUERY_MAX] = "";
+	int queryLen = 0;
+	char found[EDIT_MAX] = "";
+	int match = -1;
+	bool failed = false;
+
+	draw_search(query, found, failed);
+	while (1)
+	{
+		char c;
+		ssize_t n = read_key(&c);
+		if (n == -1 && errno == EINTR)
+		{
+			draw_search(query, found, failed);
+			continue;
+		}
+		if (n <= 0)
+			return -1;
+
+		int from = -1; // Search entries older than this
+		if (c == CTRL_KEY('r'))
+		{
+			from = (match == -1) ? history_size() : match;
+		}
+		else if (c == KEY_BACKSPACE || c == CTRL_KEY('h'))
+		{
+			if (queryLen > 0)
+				query[--queryLen] = '\0';
+			from = history_size();
+		}
+		else if (c == CTRL_KEY('g') || c == KEY_ESC)
+		{
+			refresh(e);
+			return 0;
+		}
+		else if (c == '\r' || c == '\n' || (unsigned char)c < 32)
+		{
+			if (match != -1)
+			{
+				set_line(e, found);
+				e->histPos = history_size();
+			}
+			refresh(e);
+			return (c == '\r' || c == '\n') ? 1 : 0;
+		}
+		else if (queryLen < QUERY_MAX - 1)
+		{
+			query[queryLen++] = c;
+			query[queryLen] = '\0';
+			// The current match may still contain the longer query
+			from = (match == -1) ? history_size() : match + 1;
+		}
+
+		if (from != -1 && queryLen > 0)
+		{
+			int id = history_search(query, from);
+			failed = (id == -1);
+			if (!failed)
+			{
+				match = id;
+				history_entry(match, found, sizeof(found));
+			}
+		}
+		draw_search(query, found, failed);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: insert_text(struct Edit *e, const char *text)
+ * Description: Inserts text at the cursor, as much as fits in the line.
+*******************************************************************************/
+static void insert_text(struct Edit *e, const char *text)
+{
+	int len = strlen(text);
+	if (len > EDIT_MAX - 1 - e->len)
+		len = EDIT_MAX - 1 - e->len;
+
+	memmove(e->buf + e->pos + len, e->buf + e->pos, e->len - e->pos);
+	memcpy(e->buf + e->pos, text, len);
+	e->pos += len;
+	e->len += len;
+}
+
+
+/*******************************************************************************
+ * Function: show_completions(const char *word, bool isCommand, int count)
+ * Description: Prints the completions of word in columns below the line,
+ * 				listing at most LIST_MAX of the count candidates.
+*******************************************************************************/
+static void show_completions(const char *word, bool isCommand, int count)
+{
+	char *names[LIST_MAX];
+	int numNames = complete_list(word, isCommand, names, LIST_MAX);
+
+	// Size columns to the longest name and the terminal width
+	int width = 0;
+	for (int i = 0; i < numNames; i++)
+	{
+		if ((int)strlen(names[i]) > width)
+			width = strlen(names[i]);
+	}
+	width += 2;
+	struct winsize size;
+	int columns = 80;
+	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+		columns = size.ws_col;
+	int perRow = (columns / width > 0) ? columns / width : 1;
+
+	char out[LIST_MAX * (EDIT_MAX / 16) + 64];
+	int n = snprintf(out, sizeof(out), "\n");
+	for (int i = 0; i < numNames && n < (int)sizeof(out); i++)
+	{
+		bool endOfRow = (i % perRow == perRow - 1) || i == numNames - 1;
+		n += snprintf(out + n, sizeof(out) - n, "%-*s%s", endOfRow ? 0 : width,
+			names[i], endOfRow ? "\n" : "");
+	}
+	for (int i = 0; i < numNames; i++)
+		free(names[i]);
+	if (count > numNames && n < (int)sizeof(out))
+		n += snprintf(out + n, sizeof(out) - n, "(%d more)\n", count - numNames);
+	if (n > (int)sizeof(out) - 1)
+		n = sizeof(out) - 1;
+	write_all(STDOUT_FILENO, out, n);
+}
+
+
+/*******************************************************************************
+ * Function: complete(struct Edit *e, bool listAll)
+ * Description: Completes the word before the cursor as far as every candidate
+ * 				agrees. A single candidate is finished off with a space (or a /
+ * 				for a directory). When nothing more can be added, listAll shows
+ * 				the candidates; otherwise the terminal bell is rung.
+*******************************************************************************/
+static void complete(struct Edit *e, bool listAll)
+{
+	// The word runs back from the cursor to the previous space
+	int start = e->pos;
+	while (start > 0 && e->buf[start-1] != ' ')
+		start--;
+
+	// It is the command name if nothing but spaces comes before it
+	bool isCommand = true;
+	for (int i = 0; i < start; i++)
+	{
+		if (e->buf[i] != ' ')
+			isCommand = false;
+	}
+
+	char word[EDIT_MAX];
+	snprintf(word, sizeof(word), "%.*s", e->pos - start, e->buf + start);
+
+	char extension[EDIT_MAX];
+	bool isDir;
+	int count = complete_word(word, isCommand, extension, sizeof(extension), &isDir);
+
+	insert_text(e, extension);
+	if (count == 1)
+		insert_text(e, isDir ? "/" : " ");
+	else if (count > 1 && extension[0] == '\0' && listAll)
+		show_completions(word, isCommand, count);
+	else if (count == 0 || extension[0] == '\0')
+		write_all(STDOUT_FILENO, "\a", 1);
+}
+
+
+/*******************************************************************************
+ * Function: read_escape(struct Edit *e)
+ * Description: Handles the rest of an escape sequence for the arrow, home, end
+ * 				and delete keys.
+*******************************************************************************/
+static void read_escape(struct Edit *e)
+{
+	char seq[3];
+	if (read(STDIN_FILENO, &seq[0], 1) != 1 || read(STDIN_FILENO, &seq[1], 1) != 1)
+		return;
+	if (seq[0] != '[' && seq[0] != 'O')
+		return;
+
+	switch (seq[1])
+	{
+		case 'A': browse_history(e, -1); break;
+		case 'B': browse_history(e, 1); break;
+		case 'C': if (e->pos < e->len) e->pos++; break;
+		case 'D': if (e->pos > 0) e->pos--; break;
+		case 'H': e->pos = 0; break;
+		case 'F': e->pos = e->len; break;
+		case '3': // Delete is ESC [ 3 ~
+			if (read(STDIN_FILENO, &seq[2], 1) == 1 && seq[2] == '~' && e->pos < e->len)
+			{
+				memmove(e->buf + e->pos, e->buf + e->pos + 1, e->len - e->pos - 1);
+				e->len--;
+			}
+			break;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: edit_loop(struct Edit *e)
+ * Description: Reads and applies keys until the line is submitted. Returns
+ * 				true when the line is complete, false at end of input.
+*******************************************************************************/
+static bool edit_loop(struct Edit *e)
+{
+	char lastKey = 0;
+	refresh(e);
+	while (1)
+	{
+		char c;
+		ssize_t n = read_key(&c);
+		if (n == -1 && errno == EINTR)
+		{
+			// A signal handler may have printed over the line
+			refresh(e);
+			continue;
+		}
+		if (n <= 0)
+			return false;
+
+		switch (c)
+		{
+			case '\r':
+			case '\n':
+				return true;
+
+			case KEY_TAB:
+				complete(e, lastKey == KEY_TAB);
+				break;
+
+			case CTRL_KEY('d'):
+				if (e->len == 0)
+					return false;
+				if (e->pos < e->len)
+				{
+					memmove(e->buf + e->pos, e->buf + e->pos + 1, e->len - e->pos - 1);
+					e->len--;
+				}
+				break;
+
+			case KEY_BACKSPACE:
+			case CTRL_KEY('h'):
+				if (e->pos > 0)
+				{
+					memmove(e->buf + e->pos - 1, e->buf + e->pos, e->len - e->pos);
+					e->pos--;
+					e->len--;
+				}
+				break;
+
+			case CTRL_KEY('w'):
+			{
+				int start = e->pos;
+				while (start > 0 && e->buf[start-1] == ' ')
+					start--;
+				while (start > 0 && e->buf[start-1] != ' ')
+					start--;
+				memmove(e->buf + start, e->buf + e->pos, e->len - e->pos);
+				e->len -= e->pos - start;
+				e->pos = start;
+				break;
+			}
+
+			case CTRL_KEY('u'):
+				memmove(e->buf, e->buf + e->pos, e->len - e->pos);
+				e->len -= e->pos;
+				e->pos = 0;
+				break;
+
+			case CTRL_KEY('k'): e->len = e->pos; break;
+			case CTRL_KEY('a'): e->pos = 0; break;
+			case CTRL_KEY('e'): e->pos = e->len; break;
+			case CTRL_KEY('b'): if (e->pos > 0) e->pos--; break;
+			case CTRL_KEY('f'): if (e->pos < e->len) e->pos++; break;
+			case CTRL_KEY('p'): browse_history(e, -1); break;
+			case CTRL_KEY('n'): browse_history(e, 1); break;
+			case CTRL_KEY('l'): write_all(STDOUT_FILENO, "\x1b[H\x1b[2J", 7); break;
+
+			case CTRL_KEY('r'):
+			{
+				int result = reverse_search(e);
+				if (result == -1)
+					return false;
+				if (result == 1)
+					return true;
+				break;
+			}
+
+			case KEY_ESC:
+				read_escape(e);
+				break;
+
+			default:
+				// Insert printable characters at the cursor
+				if ((unsigned char)c >= 32 && e->len < EDIT_MAX - 1)
+				{
+					memmove(e->buf + e->pos + 1, e->buf + e->pos, e->len - e->pos);
+					e->buf[e->pos++] = c;
+					e->len++;
+				}
+				break;
+		}
+		lastKey = c;
+		refresh(e);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: line_edit_read(const char *prompt, char **line, size_t *bufferSize)
+ * Description: Interactive replacement for getline(). Displays prompt, lets the
+ * 				user edit a line in raw mode and stores it, with a trailing
+ * 				newline, in *line (growing it like getline does). Returns the
+ * 				number of characters stored, or -1 at end of input.
+*******************************************************************************/
+ssize_t line_edit_read(const char *prompt, char **line, size_t *bufferSize)
+{
+	struct termios original;
+	if (tcgetattr(STDIN_FILENO, &original) == -1)
+		return -1;
+
+	// Raw mode: no line buffering or echo, keep signals and output processing
+	struct termios raw = original;
+	raw.c_iflag &= ~(ICRNL | IXON);
+	raw.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+	raw.c_cc[VMIN] = 1;
+	raw.c_cc[VTIME] = 0;
+	tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+
+	struct Edit *e = calloc(1, sizeof(struct Edit));
+	e->prompt = prompt;
+	e->histPos = history_size();
+	bool complete = edit_loop(e);
+
+	tcsetattr(STDIN_FILENO, TCSADRAIN, &original);
+	write_all(STDOUT_FILENO, "\n", 1);
+
+	ssize_t result = -1;
+	if (complete)
+	{
+		// Hand the line back the way getline() would
+		if (*line == NULL || *bufferSize < (size_t)e->len + 2)
+		{
+			*bufferSize = e->len + 2;
+			*line = realloc(*line, *bufferSize);
+		}
+		memcpy(*line, e->buf, e->len);
+		(*line)[e->len] = '\n';
+		(*line)[e->len + 1] = '\0';
+		result = e->len + 1;
+	}
+	free(e);
+	return result;
+}
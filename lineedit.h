@@ -0,0 +1,18 @@
+/*******************************************************************************
+ * File: lineedit.h
+ * Description: Raw-mode line editor used by smallsh when stdin is a terminal.
+ * 				Supports cursor movement, history navigation with the arrow
+ * 				keys, incremental reverse search with CTRL-R and TAB
+ * 				completion.
+*******************************************************************************/
+#ifndef LINEEDIT_INCLUDED
+#define LINEEDIT_INCLUDED 1
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+bool line_edit_usable(void);
+void line_edit_watch(int fd, void (*callback)(void));
+ssize_t line_edit_read(const char *prompt, char **line, size_t *bufferSize);
+
+#endif
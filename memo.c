@@ -0,0 +1,774 @@
+/*******************************************************************************
+ * File: memo.c
+ * Description: Implements the memo builtin described in memo.h. Each result is
+ * 				one file named by a 128-bit FNV-1a hash of its key, holding
+ * 				the key itself, so a hash collision is a miss rather than a
+ * 				wrong answer, the wait status and the output as a sequence of
+ * 				stdout and stderr chunks in the order they were read, so a
+ * 				replay interleaves them as the command did. A file's mtime is
+ * 				its last use, which eviction goes by. Results are written to a
+ * 				temporary file and renamed into place, so shells sharing the
+ * 				cache never see half of one. Content hashes of input files are
+ * 				remembered while their size and mtime stay the same, so a
+ * 				large input is only read once per change.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "output.h"
+#include "envstore.h"
+#include "cgroup.h"
+#include "vec.h"
+#include "memo.h"
+#include "util.h"
+
+// Constants
+#define DEFAULT_MAX (64LL * 1024 * 1024)
+#define DEFAULT_ENV "PATH"
+#define READ_SIZE (64 * 1024)
+#define PATH_LEN 4096
+#define STALE_SECONDS 3600 // Age of a temporary file left by a shell that died
+#define CHUNK_HEADER 5 // Stream number and 32-bit length
+
+typedef unsigned __int128 Hash;
+
+// A growable byte string
+struct Buffer
+{
+	char *data;
+	size_t len;
+	size_t cap;
+};
+
+// Start of each result file, followed by the key and the chunks
+struct EntryHeader
+{
+	char magic[8];
+	int32_t childExitMethod;
+	uint32_t keyLen;
+	uint64_t bodyLen;
+};
+
+// An input file's content hash, valid while its size and mtime are unchanged
+struct InputHash
+{
+	dev_t dev;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	Hash hash;
+};
+
+// A result file, for eviction and --stats
+struct CacheFile
+{
+	char *name;
+	off_t size;
+	struct timespec mtime;
+};
+
+VEC_DECLARE(InputHashVec, input_hash_vec, struct InputHash)
+VEC_DECLARE(CacheFileVec, cache_file_vec, struct CacheFile)
+
+// Globals
+static const char MAGIC[8] = "smemo01";
+static InputHashVec INPUT_HASHES = {NULL, 0, 0};
+static unsigned long HITS = 0;
+static unsigned long MISSES = 0;
+static unsigned long EVICTED = 0;
+static unsigned NEXT_TEMP = 0;
+
+
+/*******************************************************************************
+ * Function: hash_bytes(Hash hash, const void *data, size_t len)
+ * Description: Continues a 128-bit FNV-1a hash over data and returns it.
+*******************************************************************************/
+static Hash hash_bytes(Hash hash, const void *data, size_t len)
+{
+	const Hash prime = ((Hash)1 << 88) | 0x13b;
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= ((const unsigned char *)data)[i];
+		hash *= prime;
+	}
+	return hash;
+}
+
+
+/*******************************************************************************
+ * Function: hash_start()
+ * Description: Returns the FNV-1a offset basis to start a hash from.
+*******************************************************************************/
+static Hash hash_start(void)
+{
+	return ((Hash)0x6c62272e07bb0142 << 64) | 0x62b821756295c58d;
+}
+
+
+/*******************************************************************************
+ * Function: hash_hex(Hash hash, char *text)
+ * Description: Writes hash as 32 hex digits and a null byte.
+*******************************************************************************/
+static void hash_hex(Hash hash, char *text)
+{
+	sprintf(text, "%016llx%016llx", (unsigned long long)(hash >> 64),
+		(unsigned long long)hash);
+}
+
+
+/*******************************************************************************
+ * Function: buffer_add(struct Buffer *buffer, const void *data, size_t len)
+ * Description: Appends data to buffer.
+*******************************************************************************/
+static void buffer_add(struct Buffer *buffer, const void *data, size_t len)
+{
+	if (buffer->len + len > buffer->cap)
+	{
+		while (buffer->len + len > buffer->cap)
+			buffer->cap = (buffer->cap == 0) ? 4096 : buffer->cap * 2;
+		buffer->data = realloc(buffer->data, buffer->cap);
+	}
+	memcpy(buffer->data + buffer->len, data, len);
+	buffer->len += len;
+}
+
+
+/*******************************************************************************
+ * Function: key_add(struct Buffer *key, const char *text)
+ * Description: Appends text and its null byte to a key, so the words of a key
+ * 				cannot run into each other.
+*******************************************************************************/
+static void key_add(struct Buffer *key, const char *text)
+{
+	buffer_add(key, text, strlen(text) + 1);
+}
+
+
+/*******************************************************************************
+ * Function: hash_file(int fd, const struct stat *info, Hash *hash)
+ * Description: Hashes the contents of a regular file, reusing the hash from
+ * 				last time if its size and mtime have not changed. Returns false
+ * 				if it could not be read.
+*******************************************************************************/
+static bool hash_file(int fd, const struct stat *info, Hash *hash)
+{
+	for (int i = 0; i < INPUT_HASHES.size; i++)
+	{
+		struct InputHash *known = &INPUT_HASHES.items[i];
+		if (known->dev == info->st_dev && known->ino == info->st_ino)
+		{
+			if (known->size == info->st_size &&
+				known->mtime.tv_sec == info->st_mtim.tv_sec &&
+				known->mtime.tv_nsec == info->st_mtim.tv_nsec)
+			{
+				*hash = known->hash;
+				return true;
+			}
+			input_hash_vec_swap_remove(&INPUT_HASHES, i);
+			break;
+		}
+	}
+
+	// pread() leaves a redirected stdin's offset for the command
+	char *data = malloc(READ_SIZE);
+	Hash contents = hash_start();
+	off_t offset = 0;
+	ssize_t len;
+	while ((len = pread(fd, data, READ_SIZE, offset)) != 0)
+	{
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len == -1)
+		{
+			free(data);
+			return false;
+		}
+		contents = hash_bytes(contents, data, len);
+		offset += len;
+	}
+	free(data);
+
+	struct InputHash known = {info->st_dev, info->st_ino, info->st_size, info->st_mtim,
+		contents};
+	input_hash_vec_push(&INPUT_HASHES, known);
+	*hash = contents;
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: add_input(struct Buffer *key, const char *name, int fd)
+ * Description: Adds an input file's name, size, mtime and content hash to a
+ * 				key. A device such as /dev/null is added by its number.
+ * 				Returns false if the input is not a file or device, or cannot
+ * 				be read.
+*******************************************************************************/
+static bool add_input(struct Buffer *key, const char *name, int fd)
+{
+	struct stat info;
+	char text[128];
+	if (fstat(fd, &info) == -1)
+		return false;
+
+	if (S_ISCHR(info.st_mode))
+	{
+		snprintf(text, sizeof(text), "device %llx", (unsigned long long)info.st_rdev);
+	}
+	else
+	{
+		Hash contents;
+		char hex[33];
+		if (!S_ISREG(info.st_mode) || !hash_file(fd, &info, &contents))
+			return false;
+		hash_hex(contents, hex);
+		snprintf(text, sizeof(text), "%lld %lld.%09ld %s", (long long)info.st_size,
+			(long long)info.st_mtim.tv_sec, info.st_mtim.tv_nsec, hex);
+	}
+	key_add(key, name);
+	key_add(key, text);
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: build_key(char *command[], char *inputs[], int numInputs,
+ * 				int stdinFd, struct Buffer *key)
+ * Description: Builds the key for running command: its args, the variables
+ * 				named in SMALLSH_MEMO_ENV, the working directory and the
+ * 				inputs. Returns false after displaying a message if an input
+ * 				cannot be used.
+*******************************************************************************/
+static bool build_key(char *command[], char *inputs[], int numInputs, int stdinFd,
+	struct Buffer *key)
+{
+	key_add(key, "args");
+	for (int i = 0; command[i] != NULL; i++)
+		key_add(key, command[i]);
+
+	key_add(key, "env");
+	const char *names = env_get("SMALLSH_MEMO_ENV");
+	char *list = strdup((names != NULL) ? names : DEFAULT_ENV);
+	char *save;
+	for (char *name = strtok_r(list, ",", &save); name != NULL; name = strtok_r(NULL, ",", &save))
+	{
+		const char *value = env_get(name);
+		key_add(key, name);
+		key_add(key, (value != NULL) ? "set" : "unset");
+		key_add(key, (value != NULL) ? value : "");
+	}
+	free(list);
+
+	char *cwd = getcwd(NULL, 0);
+	key_add(key, "cwd");
+	key_add(key, (cwd != NULL) ? cwd : "");
+	free(cwd);
+
+	key_add(key, "inputs");
+	for (int i = 0; i < numInputs; i++)
+	{
+		int fd = open(inputs[i], O_RDONLY | O_CLOEXEC);
+		bool ok = fd != -1 && add_input(key, inputs[i], fd);
+		if (fd != -1)
+			close(fd);
+		if (!ok)
+		{
+			out_printf("memo: cannot read input %s\n", inputs[i]);
+			return false;
+		}
+	}
+	if (stdinFd != -1 && !add_input(key, "<stdin>", stdinFd))
+	{
+		out_printf("memo: stdin is not a file\n");
+		return false;
+	}
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: make_dirs(char *path)
+ * Description: Creates path and any missing parents. Returns false if it is
+ * 				not a directory afterwards.
+*******************************************************************************/
+static bool make_dirs(char *path)
+{
+	for (char *slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/'))
+	{
+		*slash = '\0';
+		mkdir(path, 0755);
+		*slash = '/';
+	}
+	mkdir(path, 0755);
+
+	struct stat info;
+	return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+
+/*******************************************************************************
+ * Function: cache_dir(char *dir)
+ * Description: Finds the cache directory, creating it if needed, and copies
+ * 				its path into dir, which holds PATH_LEN bytes. Returns false
+ * 				after displaying a message if there is none.
+*******************************************************************************/
+static bool cache_dir(char *dir)
+{
+	const char *configured = env_get("SMALLSH_MEMO_DIR");
+	const char *home = env_get("HOME");
+	if (configured != NULL && configured[0] != '\0')
+		snprintf(dir, PATH_LEN, "%s", configured);
+	else if (home != NULL && home[0] != '\0')
+		snprintf(dir, PATH_LEN, "%s/.cache/smallsh/memo", home);
+	else
+	{
+		out_printf("memo: set SMALLSH_MEMO_DIR or HOME for the cache\n");
+		return false;
+	}
+
+	if (!make_dirs(dir))
+	{
+		out_printf("memo: cannot use %s: %s\n", dir, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: older_first(const void *first, const void *second)
+ * Description: qsort() comparison putting the least recently used file first.
+*******************************************************************************/
+static int older_first(const void *first, const void *second)
+{
+	const struct timespec *a = &((const struct CacheFile *)first)->mtime;
+	const struct timespec *b = &((const struct CacheFile *)second)->mtime;
+	if (a->tv_sec != b->tv_sec)
+		return (a->tv_sec < b->tv_sec) ? -1 : 1;
+	return (a->tv_nsec < b->tv_nsec) ? -1 : (a->tv_nsec > b->tv_nsec);
+}
+
+
+/*******************************************************************************
+ * Function: scan_cache(const char *dir, CacheFileVec *files)
+ * Description: Lists the result files in dir into files, removing temporary
+ * 				files left by a shell that died. Returns their total size.
+*******************************************************************************/
+static long long scan_cache(const char *dir, CacheFileVec *files)
+{
+	cache_file_vec_init(files);
+	DIR *stream = opendir(dir);
+	if (stream == NULL)
+		return 0;
+
+	long long total = 0;
+	time_t now = time(NULL);
+	struct dirent *entry;
+	while ((entry = readdir(stream)) != NULL)
+	{
+		struct stat info;
+		size_t len = strlen(entry->d_name);
+		bool isResult = len > 5 && strcmp(entry->d_name + len - 5, ".memo") == 0;
+		bool isTemp = strncmp(entry->d_name, "tmp.", 4) == 0;
+		if ((!isResult && !isTemp) || fstatat(dirfd(stream), entry->d_name, &info, 0) == -1)
+			continue;
+
+		if (isTemp)
+		{
+			if (now - info.st_mtime > STALE_SECONDS)
+				unlinkat(dirfd(stream), entry->d_name, 0);
+			continue;
+		}
+		struct CacheFile file = {strdup(entry->d_name), info.st_size, info.st_mtim};
+		cache_file_vec_push(files, file);
+		total += info.st_size;
+	}
+	closedir(stream);
+	return total;
+}
+
+
+/*******************************************************************************
+ * Function: free_files(CacheFileVec *files)
+ * Description: Frees a list from scan_cache().
+*******************************************************************************/
+static void free_files(CacheFileVec *files)
+{
+	for (int i = 0; i < files->size; i++)
+		free(files->items[i].name);
+	cache_file_vec_free(files);
+}
+
+
+/*******************************************************************************
+ * Function: evict(const char *dir, long long limit)
+ * Description: Removes the least recently used results until the cache holds
+ * 				no more than limit bytes.
+*******************************************************************************/
+static void evict(const char *dir, long long limit)
+{
+	CacheFileVec files;
+	long long total = scan_cache(dir, &files);
+	if (total > limit)
+	{
+		qsort(files.items, files.size, sizeof(struct CacheFile), older_first);
+		int dirFd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		for (int i = 0; i < files.size && total > limit && dirFd != -1; i++)
+		{
+			if (unlinkat(dirFd, files.items[i].name, 0) == 0)
+				EVICTED++;
+			total -= files.items[i].size;
+		}
+		if (dirFd != -1)
+			close(dirFd);
+	}
+	free_files(&files);
+}
+
+
+/*******************************************************************************
+ * Function: replay(int fd, const struct Buffer *key, int stdoutFd,
+ * 				int *childExitMethod)
+ * Description: Reads the result file open on fd. If it is a complete result
+ * 				for key, writes its output to stdoutFd and stderr, sets
+ * 				childExitMethod and returns true. Otherwise writes nothing and
+ * 				returns false.
+*******************************************************************************/
+static bool replay(int fd, const struct Buffer *key, int stdoutFd, int *childExitMethod)
+{
+	struct EntryHeader header;
+	if (read(fd, &header, sizeof(header)) != sizeof(header) ||
+		memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.keyLen != key->len)
+		return false;
+
+	size_t len = header.keyLen + header.bodyLen;
+	char *data = malloc(len + 1);
+	bool ok = data != NULL && read(fd, data, len) == (ssize_t)len &&
+		memcmp(data, key->data, key->len) == 0;
+
+	// Check every chunk fits before writing any of them
+	for (size_t pos = key->len; ok && pos < len; )
+	{
+		uint32_t chunkLen;
+		if (len - pos < CHUNK_HEADER)
+		{
+			ok = false;
+			break;
+		}
+		memcpy(&chunkLen, data + pos + 1, sizeof(chunkLen));
+		ok = chunkLen <= len - pos - CHUNK_HEADER;
+		pos += CHUNK_HEADER + chunkLen;
+	}
+	for (size_t pos = key->len; ok && pos < len; )
+	{
+		uint32_t chunkLen;
+		memcpy(&chunkLen, data + pos + 1, sizeof(chunkLen));
+		write_all((data[pos] == 1) ? stdoutFd : 2, data + pos + CHUNK_HEADER, chunkLen);
+		pos += CHUNK_HEADER + chunkLen;
+	}
+	free(data);
+	if (ok)
+		*childExitMethod = header.childExitMethod;
+	return ok;
+}
+
+
+/*******************************************************************************
+ * Function: capture(int outPipe, int errPipe, int stdoutFd,
+ * 				const struct MemoRunner *runner, struct Buffer *body, size_t limit)
+ * Description: Copies a running command's stdout and stderr from their pipes
+ * 				to stdoutFd and stderr as they arrive, and records them as
+ * 				chunks in body. Returns false if the output grew past limit,
+ * 				after which it is only copied.
+*******************************************************************************/
+static bool capture(int outPipe, int errPipe, int stdoutFd, const struct MemoRunner *runner,
+	struct Buffer *body, size_t limit)
+{
+	int pipes[2] = {outPipe, errPipe};
+	int targets[2] = {stdoutFd, 2};
+	bool open[2] = {true, true};
+	bool keep = true;
+	char *data = malloc(READ_SIZE + CHUNK_HEADER);
+
+	while (open[0] || open[1])
+	{
+		struct pollfd fds[3] = {
+			{open[0] ? pipes[0] : -1, POLLIN, 0},
+			{open[1] ? pipes[1] : -1, POLLIN, 0},
+			{runner->watchFd, POLLIN, 0}
+		};
+		if (poll(fds, 3, -1) == -1)
+			continue;
+		if ((fds[2].revents & POLLIN) && runner->onWatch != NULL)
+			runner->onWatch();
+
+		for (int i = 0; i < 2; i++)
+		{
+			if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+				continue;
+			ssize_t len = read(pipes[i], data + CHUNK_HEADER, READ_SIZE);
+			if (len == -1 && errno == EINTR)
+				continue;
+			if (len <= 0)
+			{
+				open[i] = false;
+				continue;
+			}
+			write_all(targets[i], data + CHUNK_HEADER, len);
+
+			uint32_t chunkLen = len;
+			keep = keep && body->len + CHUNK_HEADER + len <= limit;
+			if (keep)
+			{
+				data[0] = i + 1;
+				memcpy(data + 1, &chunkLen, sizeof(chunkLen));
+				buffer_add(body, data, CHUNK_HEADER + len);
+			}
+		}
+	}
+	free(data);
+	return keep;
+}
+
+
+/*******************************************************************************
+ * Function: store(const char *dir, const char *path, const struct Buffer *key,
+ * 				const struct Buffer *body, int childExitMethod)
+ * Description: Writes a result to a temporary file in dir and renames it to
+ * 				path.
+*******************************************************************************/
+static void store(const char *dir, const char *path, const struct Buffer *key,
+	const struct Buffer *body, int childExitMethod)
+{
+	char temp[PATH_LEN];
+	if (snprintf(temp, sizeof(temp), "%s/tmp.%d.%u", dir, getpid(), NEXT_TEMP++) >=
+		(int)sizeof(temp))
+		return;
+	int fd = open(temp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd == -1)
+		return;
+
+	struct EntryHeader header = {{0}, childExitMethod, key->len, body->len};
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	bool ok = write_all(fd, (const char *)&header, sizeof(header)) &&
+		write_all(fd, key->data, key->len) &&
+		(body->len == 0 || write_all(fd, body->data, body->len));
+	if (close(fd) == -1)
+		ok = false;
+	if (!ok || rename(temp, path) == -1)
+		unlink(temp);
+}
+
+
+/*******************************************************************************
+ * Function: run_command(char *command[], int stdinFd, int stdoutFd,
+ * 				const struct MemoRunner *runner, struct Buffer *body, size_t limit,
+ * 				bool *keep, int *childExitMethod, bool *timedOut)
+ * Description: Runs command with its output captured into body, setting keep
+ * 				to false if the output is too big to store. Returns false if
+ * 				it could not be started.
+*******************************************************************************/
+static bool run_command(char *command[], int stdinFd, int stdoutFd,
+	const struct MemoRunner *runner, struct Buffer *body, size_t limit, bool *keep,
+	int *childExitMethod, bool *timedOut)
+{
+	*keep = false;
+	*timedOut = false;
+	int outPipe[2], errPipe[2];
+	if (pipe2(outPipe, O_CLOEXEC) == -1)
+	{
+		out_printf("memo: %s\n", strerror(errno));
+		return false;
+	}
+	if (pipe2(errPipe, O_CLOEXEC) == -1)
+	{
+		out_printf("memo: %s\n", strerror(errno));
+		close(outPipe[0]);
+		close(outPipe[1]);
+		return false;
+	}
+
+	// A command that does not read a file reads nothing
+	int inFd = (stdinFd != -1) ? stdinFd : open("/dev/null", O_RDONLY | O_CLOEXEC);
+	pid_t pid = runner->spawn(command, inFd, outPipe[1], errPipe[1]);
+	close(outPipe[1]);
+	close(errPipe[1]);
+	if (inFd != stdinFd)
+		close(inFd);
+
+	if (pid > 0)
+	{
+		*keep = capture(outPipe[0], errPipe[0], stdoutFd, runner, body, limit);
+		*timedOut = runner->wait(pid, childExitMethod);
+	}
+	close(outPipe[0]);
+	close(errPipe[0]);
+	return pid > 0;
+}
+
+
+/*******************************************************************************
+ * Function: show_stats(const char *dir)
+ * Description: Displays this shell's hit and miss counts and what the cache
+ * 				holds.
+*******************************************************************************/
+static void show_stats(const char *dir)
+{
+	CacheFileVec files;
+	long long total = scan_cache(dir, &files);
+	unsigned long lookups = HITS + MISSES;
+	out_printf("memo: %lu hits, %lu misses (%.1f%% hit), %lu evicted\n", HITS, MISSES,
+		(lookups > 0) ? 100.0 * HITS / lookups : 0.0, EVICTED);
+	out_printf("memo: %d results, %lld bytes in %s\n", files.size, total, dir);
+	free_files(&files);
+}
+
+
+/*******************************************************************************
+ * Function: clear_cache(const char *dir)
+ * Description: Removes every result from the cache.
+*******************************************************************************/
+static void clear_cache(const char *dir)
+{
+	CacheFileVec files;
+	scan_cache(dir, &files);
+	int dirFd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	for (int i = 0; i < files.size && dirFd != -1; i++)
+		unlinkat(dirFd, files.items[i].name, 0);
+	if (dirFd != -1)
+		close(dirFd);
+	out_printf("memo: removed %d results\n", files.size);
+	free_files(&files);
+}
+
+
+/*******************************************************************************
+ * Function: memo_run(char *arguments[], int stdinFd, int stdoutFd,
+ * 				const struct MemoRunner *runner, int *childExitMethod,
+ * 				bool *timedOut)
+ * Description: Takes in the memo builtin's args with any redirections removed,
+ * 				its stdin (-1 for none) and stdout, and how to run a command.
+ * 				Replays a stored result for the command or runs it and stores
+ * 				the result. Returns true and sets how the command ended, as a
+ * 				wait status, and whether it timed out if there was a command;
+ * 				returns false for --stats, --clear or after displaying a
+ * 				message if nothing could be run.
+*******************************************************************************/
+bool memo_run(char *arguments[], int stdinFd, int stdoutFd, const struct MemoRunner *runner,
+	int *childExitMethod, bool *timedOut)
+{
+	char dir[PATH_LEN];
+	*timedOut = false;
+	if (arguments[1] != NULL && (strcmp(arguments[1], "--stats") == 0 ||
+		strcmp(arguments[1], "--clear") == 0))
+	{
+		if (cache_dir(dir))
+		{
+			if (strcmp(arguments[1], "--stats") == 0)
+				show_stats(dir);
+			else
+				clear_cache(dir);
+		}
+		return false;
+	}
+
+	// Input files, given as comma separated lists
+	ArgVec inputs;
+	arg_vec_init(&inputs);
+	int first = 1;
+	while (arguments[first] != NULL && strcmp(arguments[first], "--inputs") == 0 &&
+		arguments[first+1] != NULL)
+	{
+		char *save;
+		for (char *path = strtok_r(arguments[first+1], ",", &save); path != NULL;
+			path = strtok_r(NULL, ",", &save))
+			arg_vec_push(&inputs, path);
+		first += 2;
+	}
+	char **command = &arguments[first];
+	if (command[0] == NULL || command[0][0] == '-')
+	{
+		out_printf("usage: memo [--inputs FILE,...] command\n");
+		out_printf("       memo --stats | --clear\n");
+		arg_vec_free(&inputs);
+		return false;
+	}
+
+	struct Buffer key = {NULL, 0, 0};
+	bool ok = build_key(command, inputs.items, inputs.size, stdinFd, &key);
+	arg_vec_free(&inputs);
+	if (!ok || !cache_dir(dir))
+	{
+		free(key.data);
+		return false;
+	}
+
+	const char *configured = env_get("SMALLSH_MEMO_MAX");
+	long long limit = DEFAULT_MAX;
+	if (configured != NULL && !parse_memory_size(configured, &limit))
+		limit = DEFAULT_MAX;
+
+	char path[PATH_LEN], hex[33];
+	hash_hex(hash_bytes(hash_start(), key.data, key.len), hex);
+	if (snprintf(path, sizeof(path), "%s/%s.memo", dir, hex) >= (int)sizeof(path))
+	{
+		out_printf("memo: cache path too long: %s\n", dir);
+		free(key.data);
+		return false;
+	}
+
+	// Output to a pipe whose reader has gone must not kill the shell
+	struct sigaction ignoreAction = {0}, oldAction;
+	ignoreAction.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &ignoreAction, &oldAction);
+	out_flush();
+
+	// A hit also marks the result as recently used
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	bool hit = fd != -1 && replay(fd, &key, stdoutFd, childExitMethod);
+	if (hit)
+		futimens(fd, NULL);
+	if (fd != -1)
+		close(fd);
+
+	bool ran = hit;
+	if (hit)
+	{
+		HITS++;
+	}
+	else
+	{
+		MISSES++;
+		struct Buffer body = {NULL, 0, 0};
+		size_t room = (limit > (long long)(sizeof(struct EntryHeader) + key.len)) ?
+			limit - sizeof(struct EntryHeader) - key.len : 0;
+		bool keep;
+		ran = run_command(command, stdinFd, stdoutFd, runner, &body, room, &keep,
+			childExitMethod, timedOut);
+
+		// A signal or deadline is not part of what the command computes
+		if (keep && !*timedOut && WIFEXITED(*childExitMethod))
+		{
+			store(dir, path, &key, &body, *childExitMethod);
+			evict(dir, limit);
+		}
+		free(body.data);
+	}
+
+	sigaction(SIGPIPE, &oldAction, NULL);
+	free(key.data);
+	return ran;
+}
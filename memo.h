@@ -0,0 +1,37 @@
+/*******************************************************************************
+ * File: memo.h
+ * Description: The memo builtin, which caches the results of deterministic
+ * 				commands:
+ * 					memo [--inputs FILE,...] command...
+ * 				looks up command in an on-disk cache keyed by its args, the
+ * 				variables named in SMALLSH_MEMO_ENV (PATH by default), the
+ * 				working directory and the size, mtime and contents of each
+ * 				input file and of a redirected stdin. On a hit the stored
+ * 				stdout, stderr and exit status are replayed without running
+ * 				anything; on a miss the command runs and its result is stored,
+ * 				unless it was killed by a signal. The cache lives in
+ * 				SMALLSH_MEMO_DIR, or ~/.cache/smallsh/memo, and the least
+ * 				recently used results are removed once it holds more than
+ * 				SMALLSH_MEMO_MAX bytes (64M by default).
+ * 					memo --stats	displays the hit and miss counts
+ * 					memo --clear	empties the cache
+*******************************************************************************/
+#ifndef MEMO_INCLUDED
+#define MEMO_INCLUDED 1
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+// Struct for how memo runs a command on a miss
+struct MemoRunner
+{
+	pid_t (*spawn)(char *command[], int stdinFd, int stdoutFd, int stderrFd);
+	bool (*wait)(pid_t pid, int *childExitMethod); // Returns true if it timed out
+	int watchFd; // Serviced with onWatch() while the output is read
+	void (*onWatch)(void);
+};
+
+bool memo_run(char *arguments[], int stdinFd, int stdoutFd, const struct MemoRunner *runner,
+	int *childExitMethod, bool *timedOut);
+
+#endif
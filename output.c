@@ -0,0 +1,181 @@
+/*******************************************************************************
+ * File: output.c
+ * Description: Implements the shell output queue. Formatted messages are
+ * 				copied into one growing buffer; constant strings such as the
+ * 				prompt are queued by reference without copying. out_flush()
+ * 				turns the queue into an iovec array and hands it to writev().
+ * 				Setting SMALLSH_UNBATCHED_OUTPUT flushes after every message,
+ * 				which is how the shell behaved before and is kept for comparing
+ * 				syscall counts.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+#include "output.h"
+#include "envstore.h"
+
+// Constants
+#define MAX_SEGMENTS 64 // Segments per writev(), well under IOV_MAX
+#define INIT_BUFFER 1024
+
+// A queued piece of output: either a constant string or a span of BUFFER
+struct Segment
+{
+	const char *data; // NULL if the text is in BUFFER
+	size_t offset;
+	size_t len;
+};
+
+// Globals
+static char *BUFFER = NULL;
+static size_t BUFFER_USED = 0;
+static size_t BUFFER_CAP = 0;
+static struct Segment *SEGMENTS = NULL;
+static int NUM_SEGMENTS = 0;
+static int SEGMENTS_CAP = 0;
+static int UNBATCHED = -1; // Read from the environment on first use
+
+
+/*******************************************************************************
+ * Function: add_segment(const char *data, size_t offset, size_t len)
+ * Description: Queues a segment, merging it into the previous one when both
+ * 				are contiguous text in BUFFER.
+*******************************************************************************/
+static void add_segment(const char *data, size_t offset, size_t len)
+{
+	if (NUM_SEGMENTS > 0 && data == NULL)
+	{
+		struct Segment *last = &SEGMENTS[NUM_SEGMENTS-1];
+		if (last->data == NULL && last->offset + last->len == offset)
+		{
+			last->len += len;
+			return;
+		}
+	}
+
+	if (NUM_SEGMENTS == SEGMENTS_CAP)
+	{
+		SEGMENTS_CAP = (SEGMENTS_CAP == 0) ? 16 : SEGMENTS_CAP * 2;
+		SEGMENTS = realloc(SEGMENTS, SEGMENTS_CAP * sizeof(struct Segment));
+	}
+	SEGMENTS[NUM_SEGMENTS].data = data;
+	SEGMENTS[NUM_SEGMENTS].offset = offset;
+	SEGMENTS[NUM_SEGMENTS].len = len;
+	NUM_SEGMENTS++;
+}
+
+
+/*******************************************************************************
+ * Function: flush_if_unbatched()
+ * Description: Flushes right away when batching has been turned off.
+*******************************************************************************/
+static void flush_if_unbatched(void)
+{
+	if (UNBATCHED == -1)
+		UNBATCHED = env_get("SMALLSH_UNBATCHED_OUTPUT") != NULL;
+	if (UNBATCHED)
+		out_flush();
+}
+
+
+/*******************************************************************************
+ * Function: out_printf(const char *format, ...)
+ * Description: Formats a message like printf() and queues a copy of it.
+*******************************************************************************/
+void out_printf(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	if (len <= 0)
+		return;
+
+	if (BUFFER_USED + len + 1 > BUFFER_CAP)
+	{
+		BUFFER_CAP = (BUFFER_CAP == 0) ? INIT_BUFFER : BUFFER_CAP;
+		while (BUFFER_USED + len + 1 > BUFFER_CAP)
+			BUFFER_CAP *= 2;
+		BUFFER = realloc(BUFFER, BUFFER_CAP);
+	}
+
+	va_start(args, format);
+	vsnprintf(BUFFER + BUFFER_USED, len + 1, format, args);
+	va_end(args);
+
+	add_segment(NULL, BUFFER_USED, len);
+	BUFFER_USED += len;
+	flush_if_unbatched();
+}
+
+
+/*******************************************************************************
+ * Function: out_write(const char *data, size_t len)
+ * Description: Queues len bytes of data without copying them. data must stay
+ * 				valid until the next flush, so this is meant for constants.
+*******************************************************************************/
+void out_write(const char *data, size_t len)
+{
+	if (len == 0)
+		return;
+	add_segment(data, 0, len);
+	flush_if_unbatched();
+}
+
+
+/*******************************************************************************
+ * Function: out_flush()
+ * Description: Writes everything queued to stdout, MAX_SEGMENTS segments per
+ * 				writev(), finishing any partial or interrupted writes, and
+ * 				empties the queue.
+*******************************************************************************/
+void out_flush(void)
+{
+	struct iovec iov[MAX_SEGMENTS];
+	int next = 0;
+
+	while (next < NUM_SEGMENTS)
+	{
+		int count = 0;
+		for (; count < MAX_SEGMENTS && next + count < NUM_SEGMENTS; count++)
+		{
+			struct Segment *seg = &SEGMENTS[next + count];
+			iov[count].iov_base = (char *)(seg->data != NULL ? seg->data : BUFFER + seg->offset);
+			iov[count].iov_len = seg->len;
+		}
+		next += count;
+
+		// Keep going until this batch is fully written
+		int first = 0;
+		while (first < count)
+		{
+			ssize_t written = writev(STDOUT_FILENO, iov + first, count - first);
+			if (written == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				first = count; // Nowhere to write, so drop the output
+				break;
+			}
+			while (first < count && (size_t)written >= iov[first].iov_len)
+			{
+				written -= iov[first].iov_len;
+				first++;
+			}
+			if (first < count)
+			{
+				iov[first].iov_base = (char *)iov[first].iov_base + written;
+				iov[first].iov_len -= written;
+			}
+		}
+	}
+
+	NUM_SEGMENTS = 0;
+	BUFFER_USED = 0;
+}
@@ -0,0 +1,19 @@
+/*******************************************************************************
+ * File: output.h
+ * Description: Output layer for messages generated by the shell itself, such
+ * 				as prompts, background job reports and built in command output.
+ * 				Messages are queued and written together with one writev() per
+ * 				prompt cycle. The queue must be flushed before anything else
+ * 				(a forked child, the line editor) can write to stdout so the
+ * 				order on the terminal matches the order of events.
+*******************************************************************************/
+#ifndef OUTPUT_INCLUDED
+#define OUTPUT_INCLUDED 1
+
+#include <stddef.h>
+
+void out_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void out_write(const char *data, size_t len);
+void out_flush(void);
+
+#endif
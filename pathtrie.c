@@ -0,0 +1,467 @@
+/*******************************************************************************
+ * File: pathtrie.c
+ * Description: Implements the $PATH executable trie. Each node records which
+ * 				PATH directories hold the name ending at it (one bit per
+ * 				directory, so the lowest set bit is the one exec would pick)
+ * 				and how many names live at or below it, which lets completion
+ * 				find the common extension of a prefix without visiting every
+ * 				match. Nodes come from a block allocator and are never freed
+ * 				one at a time; a name that disappears just has its bits and
+ * 				counts cleared. Only the first MAX_DIRS absolute PATH entries
+ * 				are indexed; anything else is still found by execvp().
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "pathtrie.h"
+#include "envstore.h"
+
+// Constants
+#define MAX_DIRS 64
+#define MAX_NAME 256
+#define MAX_PATH 4096
+#define BLOCK_NODES 4096
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+	IN_ATTRIB | IN_ONLYDIR)
+
+struct TrieNode
+{
+	struct TrieNode *child; // First child, children sorted by ch
+	struct TrieNode *next; // Next sibling
+	unsigned long long dirs; // Bit i set if DIRS[i] holds this name
+	int words; // Names at or below this node
+	unsigned char ch;
+};
+
+struct NodeBlock
+{
+	struct NodeBlock *next;
+	int used;
+	struct TrieNode nodes[BLOCK_NODES];
+};
+
+// Globals
+static struct TrieNode ROOT;
+static struct NodeBlock *BLOCKS = NULL;
+static bool BUILT = false;
+static char *TRIE_PATH = NULL; // Value of $PATH the trie was built from
+static char *DIRS[MAX_DIRS];
+static int WATCHES[MAX_DIRS]; // inotify watch descriptor of each dir
+static int NUM_DIRS = 0;
+static int NUM_LEADING = 0; // DIRS before the first PATH entry left out
+static int INOTIFY_FD = -1;
+static char LOOKUP[MAX_PATH]; // Result of the last path_trie_lookup()
+
+
+/*******************************************************************************
+ * Function: new_node(unsigned char ch)
+ * Description: Returns a zeroed node for ch from the block allocator.
+*******************************************************************************/
+static struct TrieNode *new_node(unsigned char ch)
+{
+	if (BLOCKS == NULL || BLOCKS->used == BLOCK_NODES)
+	{
+		struct NodeBlock *block = calloc(1, sizeof(struct NodeBlock));
+		block->next = BLOCKS;
+		BLOCKS = block;
+	}
+
+	struct TrieNode *node = &BLOCKS->nodes[BLOCKS->used++];
+	node->ch = ch;
+	return node;
+}
+
+
+/*******************************************************************************
+ * Function: find_child(struct TrieNode *node, unsigned char ch, bool create)
+ * Description: Returns node's child for ch, adding it in sorted position if
+ * 				create is true. Returns NULL if there is no such child and
+ * 				create is false.
+*******************************************************************************/
+static struct TrieNode *find_child(struct TrieNode *node, unsigned char ch, bool create)
+{
+	struct TrieNode **link = &node->child;
+	while (*link != NULL && (*link)->ch < ch)
+		link = &(*link)->next;
+
+	if (*link != NULL && (*link)->ch == ch)
+		return *link;
+	if (!create)
+		return NULL;
+
+	struct TrieNode *child = new_node(ch);
+	child->next = *link;
+	*link = child;
+	return child;
+}
+
+
+/*******************************************************************************
+ * Function: find_node(const char *prefix)
+ * Description: Returns the node reached by prefix, or NULL if no name starts
+ * 				with it.
+*******************************************************************************/
+static struct TrieNode *find_node(const char *prefix)
+{
+	struct TrieNode *node = &ROOT;
+	for (int i = 0; prefix[i] != '\0' && node != NULL; i++)
+		node = find_child(node, prefix[i], false);
+
+	if (node == NULL || node->words == 0)
+		return NULL;
+	return node;
+}
+
+
+/*******************************************************************************
+ * Function: set_name(const char *name, int dir, bool present)
+ * Description: Records whether DIRS[dir] holds an executable called name. The
+ * 				word counts along the name are only touched when the name goes
+ * 				from being in no directory to some directory or back.
+*******************************************************************************/
+static void set_name(const char *name, int dir, bool present)
+{
+	struct TrieNode *path[MAX_NAME + 1];
+	int depth = 0;
+
+	path[0] = &ROOT;
+	for (int i = 0; name[i] != '\0'; i++)
+	{
+		if (depth == MAX_NAME)
+			return;
+		path[depth+1] = find_child(path[depth], name[i], present);
+		if (path[depth+1] == NULL)
+			return; // Removing a name that was never added
+		depth++;
+	}
+
+	struct TrieNode *node = path[depth];
+	bool wasPresent = node->dirs != 0;
+	if (present)
+		node->dirs |= 1ULL << dir;
+	else
+		node->dirs &= ~(1ULL << dir);
+
+	// Only update counts if the name appeared or disappeared
+	if (wasPresent != (node->dirs != 0))
+	{
+		for (int i = 0; i <= depth; i++)
+			path[i]->words += present ? 1 : -1;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: is_executable(int dirFd, const char *name)
+ * Description: Returns true if name in the directory open as dirFd is a file
+ * 				(or link to one) with an execute bit set.
+*******************************************************************************/
+static bool is_executable(int dirFd, const char *name)
+{
+	struct stat info;
+	if (fstatat(dirFd, name, &info, 0) == -1)
+		return false;
+	return S_ISREG(info.st_mode) && (info.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH));
+}
+
+
+/*******************************************************************************
+ * Function: scan_dir(int dir)
+ * Description: Adds every executable in DIRS[dir] to the trie.
+*******************************************************************************/
+static void scan_dir(int dir)
+{
+	DIR *stream = opendir(DIRS[dir]);
+	if (stream == NULL)
+		return;
+
+	struct dirent *entry;
+	while ((entry = readdir(stream)) != NULL)
+	{
+		if (entry->d_name[0] == '.' || entry->d_type == DT_DIR)
+			continue;
+		if (is_executable(dirfd(stream), entry->d_name))
+			set_name(entry->d_name, dir, true);
+	}
+	closedir(stream);
+}
+
+
+/*******************************************************************************
+ * Function: teardown()
+ * Description: Frees every node and directory and closes the inotify watches.
+*******************************************************************************/
+static void teardown(void)
+{
+	while (BLOCKS != NULL)
+	{
+		struct NodeBlock *next = BLOCKS->next;
+		free(BLOCKS);
+		BLOCKS = next;
+	}
+	memset(&ROOT, 0, sizeof(ROOT));
+
+	for (int i = 0; i < NUM_DIRS; i++)
+		free(DIRS[i]);
+	NUM_DIRS = 0;
+	NUM_LEADING = 0;
+
+	if (INOTIFY_FD != -1)
+		close(INOTIFY_FD);
+	INOTIFY_FD = -1;
+
+	free(TRIE_PATH);
+	TRIE_PATH = NULL;
+	BUILT = false;
+}
+
+
+/*******************************************************************************
+ * Function: path_trie_build()
+ * Description: Builds the trie from the current $PATH. Each directory is
+ * 				watched before it is scanned so nothing added during the scan
+ * 				is missed. Directories that are relative (or empty, meaning
+ * 				the working directory) or cannot be watched are left out and
+ * 				handled by execvp() as before, and the directories after the
+ * 				first of them are not used for lookups.
+*******************************************************************************/
+void path_trie_build(void)
+{
+	if (BUILT)
+		teardown();
+
+	const char *path = env_get("PATH");
+	TRIE_PATH = strdup(path != NULL ? path : "");
+	INOTIFY_FD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	// Empty entries count, so split without strtok()
+	char *copy = strdup(TRIE_PATH);
+	char *rest = copy;
+	bool leftOut = false;
+	while (rest != NULL && NUM_DIRS < MAX_DIRS)
+	{
+		char *dir = strsep(&rest, ":");
+		int watch = -1;
+		if (dir[0] == '/' && INOTIFY_FD != -1)
+			watch = inotify_add_watch(INOTIFY_FD, dir, WATCH_EVENTS);
+		if (dir[0] == '/' && (watch != -1 || INOTIFY_FD == -1))
+		{
+			DIRS[NUM_DIRS] = strdup(dir);
+			WATCHES[NUM_DIRS] = watch;
+			scan_dir(NUM_DIRS);
+			NUM_DIRS++;
+			if (!leftOut)
+				NUM_LEADING = NUM_DIRS;
+		}
+		else
+			leftOut = true;
+	}
+	free(copy);
+	BUILT = true;
+}
+
+
+/*******************************************************************************
+ * Function: path_trie_built()
+ * Description: Returns true if the trie has been built.
+*******************************************************************************/
+bool path_trie_built(void)
+{
+	return BUILT;
+}
+
+
+/*******************************************************************************
+ * Function: apply_event(struct inotify_event *event)
+ * Description: Updates the trie for one inotify event in every directory that
+ * 				shares the event's watch.
+*******************************************************************************/
+static void apply_event(struct inotify_event *event)
+{
+	if (event->len == 0 || event->name[0] == '.')
+		return;
+
+	for (int i = 0; i < NUM_DIRS; i++)
+	{
+		if (WATCHES[i] != event->wd)
+			continue;
+
+		bool present = false;
+		if (event->mask & (IN_CREATE | IN_MOVED_TO | IN_ATTRIB))
+		{
+			int dirFd = open(DIRS[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+			if (dirFd != -1)
+			{
+				present = is_executable(dirFd, event->name);
+				close(dirFd);
+			}
+		}
+		set_name(event->name, i, present);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: path_trie_sync()
+ * Description: Brings a built trie up to date. Pending inotify events are
+ * 				applied, and if $PATH itself has changed the trie is thrown
+ * 				away to be rebuilt lazily. Costs one non-blocking read when
+ * 				nothing has changed. Must be called in the shell process, not a
+ * 				forked child, so the events are not lost.
+*******************************************************************************/
+void path_trie_sync(void)
+{
+	if (!BUILT)
+		return;
+
+	const char *path = env_get("PATH");
+	if (strcmp(TRIE_PATH, path != NULL ? path : "") != 0)
+	{
+		teardown();
+		return;
+	}
+
+	if (INOTIFY_FD == -1)
+		return;
+
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	while ((len = read(INOTIFY_FD, events, sizeof(events))) > 0)
+	{
+		char *pos = events;
+		while (pos < events + len)
+		{
+			struct inotify_event *event = (struct inotify_event *)pos;
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				// Missed events, so start over on next use
+				teardown();
+				return;
+			}
+			apply_event(event);
+			pos += sizeof(struct inotify_event) + event->len;
+		}
+	}
+}
+
+
+/*******************************************************************************
+ * Function: path_trie_lookup(const char *name)
+ * Description: Returns the full path exec would use for command name, from the
+ * 				first PATH directory that holds it, or NULL if the trie is not
+ * 				built or does not know the name. A name first found after a
+ * 				PATH entry the trie left out could be shadowed by that entry,
+ * 				so it is also NULL. The result is overwritten by the next call.
+*******************************************************************************/
+const char *path_trie_lookup(const char *name)
+{
+	if (!BUILT || strchr(name, '/') != NULL)
+		return NULL;
+
+	struct TrieNode *node = &ROOT;
+	for (int i = 0; name[i] != '\0' && node != NULL; i++)
+		node = find_child(node, name[i], false);
+	if (node == NULL || node->dirs == 0)
+		return NULL;
+
+	int dir = __builtin_ctzll(node->dirs);
+	if (dir >= NUM_LEADING)
+		return NULL;
+	snprintf(LOOKUP, sizeof(LOOKUP), "%s/%s", DIRS[dir], name);
+	return LOOKUP;
+}
+
+
+/*******************************************************************************
+ * Function: path_trie_complete(const char *prefix, char *extension, int extensionSize)
+ * Description: Returns the number of command names starting with prefix and
+ * 				stores in extension the characters every one of them has after
+ * 				prefix. Follows single-child nodes from the prefix, so the cost
+ * 				depends on the length of the extension, not the number of
+ * 				matches.
+*******************************************************************************/
+int path_trie_complete(const char *prefix, char *extension, int extensionSize)
+{
+	extension[0] = '\0';
+	struct TrieNode *node = find_node(prefix);
+	if (node == NULL)
+		return 0;
+
+	int count = node->words;
+	int len = 0;
+	while (node->dirs == 0 && len < extensionSize - 1)
+	{
+		// Stop where the live names branch
+		struct TrieNode *only = NULL;
+		int live = 0;
+		for (struct TrieNode *c = node->child; c != NULL; c = c->next)
+		{
+			if (c->words > 0)
+			{
+				only = c;
+				live++;
+			}
+		}
+		if (live != 1)
+			break;
+
+		extension[len++] = only->ch;
+		node = only;
+	}
+	extension[len] = '\0';
+	return count;
+}
+
+
+/*******************************************************************************
+ * Function: collect(struct TrieNode *node, char *name, int depth, char *names[], int *count, int maxNames)
+ * Description: Adds the names at or below node to names in sorted order until
+ * 				maxNames have been found.
+*******************************************************************************/
+static void collect(struct TrieNode *node, char *name, int depth, char *names[],
+	int *count, int maxNames)
+{
+	if (node->dirs != 0 && *count < maxNames)
+	{
+		name[depth] = '\0';
+		names[(*count)++] = strdup(name);
+	}
+
+	for (struct TrieNode *c = node->child; c != NULL && *count < maxNames; c = c->next)
+	{
+		if (c->words > 0 && depth < MAX_NAME - 1)
+		{
+			name[depth] = c->ch;
+			collect(c, name, depth + 1, names, count, maxNames);
+		}
+	}
+}
+
+
+/*******************************************************************************
+ * Function: path_trie_list(const char *prefix, char *names[], int maxNames)
+ * Description: Fills names with up to maxNames command names starting with
+ * 				prefix, sorted. Returns how many were stored; the caller frees
+ * 				each one.
+*******************************************************************************/
+int path_trie_list(const char *prefix, char *names[], int maxNames)
+{
+	struct TrieNode *node = find_node(prefix);
+	if (node == NULL || strlen(prefix) >= MAX_NAME)
+		return 0;
+
+	char name[MAX_NAME];
+	strcpy(name, prefix);
+	int count = 0;
+	collect(node, name, strlen(prefix), names, &count, maxNames);
+	return count;
+}
@@ -0,0 +1,21 @@
+/*******************************************************************************
+ * File: pathtrie.h
+ * Description: Trie of the executable names found in the $PATH directories.
+ * 				It is built the first time it is needed and then kept current
+ * 				with inotify, and backs both command name completion and the
+ * 				command lookup done before exec.
+*******************************************************************************/
+#ifndef PATHTRIE_INCLUDED
+#define PATHTRIE_INCLUDED 1
+
+#include <stdbool.h>
+
+void path_trie_build(void);
+bool path_trie_built(void);
+void path_trie_sync(void);
+
+const char *path_trie_lookup(const char *name);
+int path_trie_complete(const char *prefix, char *extension, int extensionSize);
+int path_trie_list(const char *prefix, char *names[], int maxNames);
+
+#endif
@@ -0,0 +1,144 @@
+/*******************************************************************************
+ * File: placement.c
+ * Description: Implements job placement. The automatic mode hands each
+ * 				background job the next CPU of SMALLSH_BG_CPUS in turn, so a
+ * 				batch of CPU-heavy jobs spreads over that set instead of
+ * 				landing wherever the scheduler first puts them. Placement is
+ * 				best effort: if a setting is refused (for example a negative
+ * 				nice level without privilege) a warning is printed and the
+ * 				command still runs.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "output.h"
+#include "envstore.h"
+#include "placement.h"
+
+// Globals
+static int NEXT_CPU = 0; // Position in SMALLSH_BG_CPUS of the next job's CPU
+
+
+/*******************************************************************************
+ * Function: parse_cpuset(const char *text, cpu_set_t *cpus)
+ * Description: Parses a CPU list such as 0-3,6,8-9 into cpus. Returns false if
+ * 				the text is not a valid, non-empty list.
+*******************************************************************************/
+bool parse_cpuset(const char *text, cpu_set_t *cpus)
+{
+	CPU_ZERO(cpus);
+	const char *pos = text;
+	while (*pos != '\0')
+	{
+		char *end;
+		long first = strtol(pos, &end, 10);
+		if (end == pos || first < 0)
+			return false;
+		long last = first;
+
+		if (*end == '-')
+		{
+			pos = end + 1;
+			last = strtol(pos, &end, 10);
+			if (end == pos || last < first)
+				return false;
+		}
+		if (last >= CPU_SETSIZE)
+			return false;
+
+		for (long cpu = first; cpu <= last; cpu++)
+			CPU_SET(cpu, cpus);
+
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return false;
+		pos = end;
+	}
+	return CPU_COUNT(cpus) > 0;
+}
+
+
+/*******************************************************************************
+ * Function: parse_nice(const char *text, int *nice)
+ * Description: Parses a nice level from -20 to 19. Returns false if text is
+ * 				not one.
+*******************************************************************************/
+bool parse_nice(const char *text, int *nice)
+{
+	char *end;
+	errno = 0;
+	long value = strtol(text, &end, 10);
+	if (text[0] == '\0' || *end != '\0' || errno != 0 || value < -20 || value > 19)
+		return false;
+	*nice = value;
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: placement_background_defaults(struct Placement *placement)
+ * Description: Fills in whatever the pin prefix left unset for a background
+ * 				job from the shell settings. With SMALLSH_BG_CPUS set, the job
+ * 				is pinned to the next CPU of that set in round-robin order.
+*******************************************************************************/
+void placement_background_defaults(struct Placement *placement)
+{
+	const char *cpuList = env_get("SMALLSH_BG_CPUS");
+	cpu_set_t pool;
+	if (!placement->hasCpus && cpuList != NULL && parse_cpuset(cpuList, &pool))
+	{
+		// Find the NEXT_CPU'th CPU in the pool
+		int index = NEXT_CPU % CPU_COUNT(&pool);
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (CPU_ISSET(cpu, &pool) && index-- == 0)
+			{
+				CPU_ZERO(&placement->cpus);
+				CPU_SET(cpu, &placement->cpus);
+				placement->hasCpus = true;
+				break;
+			}
+		}
+		NEXT_CPU++;
+	}
+
+	const char *niceLevel = env_get("SMALLSH_BG_NICE");
+	if (!placement->hasNice && niceLevel != NULL && parse_nice(niceLevel, &placement->nice))
+		placement->hasNice = true;
+
+	const char *batch = env_get("SMALLSH_BG_BATCH");
+	if (batch != NULL && strcmp(batch, "1") == 0)
+		placement->batch = true;
+}
+
+
+/*******************************************************************************
+ * Function: placement_apply(const struct Placement *placement)
+ * Description: Applies placement to the calling process. Meant to be called in
+ * 				a forked child before exec.
+*******************************************************************************/
+void placement_apply(const struct Placement *placement)
+{
+	if (placement->batch)
+	{
+		struct sched_param param = {0};
+		if (sched_setscheduler(0, SCHED_BATCH, &param) == -1)
+			out_printf("pin: cannot use SCHED_BATCH: %s\n", strerror(errno));
+	}
+
+	if (placement->hasNice && setpriority(PRIO_PROCESS, 0, placement->nice) == -1)
+		out_printf("pin: cannot set nice %d: %s\n", placement->nice, strerror(errno));
+
+	if (placement->hasCpus && sched_setaffinity(0, sizeof(cpu_set_t), &placement->cpus) == -1)
+		out_printf("pin: cannot set CPU affinity: %s\n", strerror(errno));
+
+	out_flush();
+}
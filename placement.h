@@ -0,0 +1,31 @@
+/*******************************************************************************
+ * File: placement.h
+ * Description: CPU and scheduling placement for jobs: CPU affinity, nice level
+ * 				and SCHED_BATCH, applied in the child before exec. Set per
+ * 				command with the pin prefix, or for every background job
+ * 				through SMALLSH_BG_CPUS (round-robin over the set),
+ * 				SMALLSH_BG_NICE and SMALLSH_BG_BATCH. cpu_set_t needs
+ * 				_GNU_SOURCE defined before the first system header.
+*******************************************************************************/
+#ifndef PLACEMENT_INCLUDED
+#define PLACEMENT_INCLUDED 1
+
+#include <stdbool.h>
+#include <sched.h>
+
+// Struct for how a job should be placed
+struct Placement
+{
+	bool hasCpus;
+	cpu_set_t cpus;
+	bool hasNice;
+	int nice;
+	bool batch; // Run under SCHED_BATCH
+};
+
+bool parse_cpuset(const char *text, cpu_set_t *cpus);
+bool parse_nice(const char *text, int *nice);
+void placement_background_defaults(struct Placement *placement);
+void placement_apply(const struct Placement *placement);
+
+#endif
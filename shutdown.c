@@ -0,0 +1,223 @@
+/*******************************************************************************
+ * File: shutdown.c
+ * Description: Implements the shutdown engine. Every background job leads its
+ * 				own process group, so SIGTERM goes to the whole group. Exits are
+ * 				waited for on pidfds in a single epoll set, which makes the wait
+ * 				bounded by the deadline rather than by the number of jobs. Jobs
+ * 				that cannot get a pidfd (old kernel, or out of descriptors) are
+ * 				polled with waitpid() between epoll waits instead.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "vec.h"
+#include "shutdown.h"
+#include "util.h"
+
+// Constants
+#define POLL_MS 10 // How often jobs without a pidfd are checked
+#define KILL_GRACE_MS 1000 // How long SIGKILLed jobs get to be reaped
+#define MAX_EVENTS 256
+
+// One job being shut down
+struct Job
+{
+	pid_t pid;
+	int pidfd; // -1 if the job is polled instead
+	bool done;
+};
+
+
+/*******************************************************************************
+ * Function: signal_job(pid_t pid, int signo)
+ * Description: Sends signo to the process group led by pid, or just to pid if
+ * 				it does not lead a group.
+*******************************************************************************/
+static void signal_job(pid_t pid, int signo)
+{
+	if (killpg(pid, signo) == -1)
+		kill(pid, signo);
+}
+
+
+/*******************************************************************************
+ * Function: try_reap(struct Job *job)
+ * Description: Reaps job if it has exited. Returns true once it is done.
+*******************************************************************************/
+static bool try_reap(struct Job *job)
+{
+	if (job->done)
+		return true;
+
+	int childExitMethod;
+	pid_t result = waitpid(job->pid, &childExitMethod, WNOHANG);
+
+	// A job adopted from an earlier shell may not be a child, so it is only
+	// done once its pidfd, or kill(), says it has gone
+	if (result == -1 && errno == ECHILD)
+	{
+		struct pollfd exited = {job->pidfd, POLLIN, 0};
+		if ((job->pidfd != -1) ? poll(&exited, 1, 0) == 0 : kill(job->pid, 0) == 0)
+			return false;
+	}
+	if (result == job->pid || (result == -1 && errno == ECHILD))
+	{
+		job->done = true;
+		if (job->pidfd != -1)
+			close(job->pidfd);
+		job->pidfd = -1;
+	}
+	return job->done;
+}
+
+
+/*******************************************************************************
+ * Function: wait_for_jobs(struct Job jobs[], int numJobs, int epollFd, long deadline)
+ * Description: Waits until every job has been reaped or the monotonic clock
+ * 				reaches deadline. Returns the number of jobs reaped.
+*******************************************************************************/
+static int wait_for_jobs(struct Job jobs[], int numJobs, int epollFd, long deadline)
+{
+	int reaped = 0;
+	int polled = 0; // Jobs with no pidfd, which need checking by hand
+
+	for (int i = 0; i < numJobs; i++)
+	{
+		if (try_reap(&jobs[i]))
+			reaped++;
+		else if (jobs[i].pidfd == -1)
+			polled++;
+	}
+
+	struct epoll_event events[MAX_EVENTS];
+	while (reaped < numJobs)
+	{
+		long remaining = deadline - now_ms();
+		if (remaining <= 0)
+			break;
+		if (polled > 0 && remaining > POLL_MS)
+			remaining = POLL_MS;
+
+		int ready = epoll_wait(epollFd, events, MAX_EVENTS, remaining);
+		for (int i = 0; i < ready; i++)
+		{
+			struct Job *job = &jobs[events[i].data.u32];
+			if (try_reap(job))
+				reaped++;
+		}
+
+		// Check the jobs that have no pidfd
+		if (polled > 0)
+		{
+			polled = 0;
+			for (int i = 0; i < numJobs; i++)
+			{
+				if (jobs[i].pidfd != -1 || jobs[i].done)
+					continue;
+				if (try_reap(&jobs[i]))
+					reaped++;
+				else
+					polled++;
+			}
+		}
+	}
+	return reaped;
+}
+
+
+/*******************************************************************************
+ * Function: raise_fd_limit()
+ * Description: Raises the soft open file limit to the hard limit so there can
+ * 				be a pidfd for as many jobs as possible.
+*******************************************************************************/
+static void raise_fd_limit(void)
+{
+	struct rlimit limit;
+	if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: shutdown_jobs(PidVec *cpids, long deadlineMs, struct ShutdownReport *report)
+ * Description: Takes in the array of background child pids and how long they
+ * 				get to exit. Sends SIGTERM to every job's process group, waits up
+ * 				to deadlineMs for them to exit, then sends SIGKILL to the rest
+ * 				and reaps them. The counts are stored in report.
+*******************************************************************************/
+void shutdown_jobs(PidVec *cpids, long deadlineMs, struct ShutdownReport *report)
+{
+	long start = now_ms();
+	int numJobs = cpids->size;
+	memset(report, 0, sizeof(struct ShutdownReport));
+	report->jobs = numJobs;
+	if (numJobs == 0)
+		return;
+
+	raise_fd_limit();
+	int epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+	// Get a pidfd for each job before signaling so no exit is missed
+	struct Job *jobs = calloc(numJobs, sizeof(struct Job));
+	for (int i = 0; i < numJobs; i++)
+	{
+		jobs[i].pid = cpids->items[i];
+		jobs[i].pidfd = -1;
+#ifdef SYS_pidfd_open
+		if (epollFd != -1)
+			jobs[i].pidfd = syscall(SYS_pidfd_open, jobs[i].pid, 0);
+#endif
+		if (jobs[i].pidfd != -1)
+		{
+			struct epoll_event event = {0};
+			event.events = EPOLLIN;
+			event.data.u32 = i;
+			epoll_ctl(epollFd, EPOLL_CTL_ADD, jobs[i].pidfd, &event);
+		}
+	}
+
+	for (int i = 0; i < numJobs; i++)
+		signal_job(jobs[i].pid, SIGTERM);
+	report->exited = wait_for_jobs(jobs, numJobs, epollFd, start + deadlineMs);
+
+	// Escalate for the stragglers
+	for (int i = 0; i < numJobs; i++)
+	{
+		if (!jobs[i].done)
+		{
+			signal_job(jobs[i].pid, SIGKILL);
+			report->killed++;
+		}
+	}
+	if (report->killed > 0)
+	{
+		int reaped = wait_for_jobs(jobs, numJobs, epollFd, now_ms() + KILL_GRACE_MS);
+		report->lost = numJobs - reaped;
+	}
+
+	for (int i = 0; i < numJobs; i++)
+	{
+		if (jobs[i].pidfd != -1)
+			close(jobs[i].pidfd);
+	}
+	free(jobs);
+	if (epollFd != -1)
+		close(epollFd);
+
+	report->elapsedMs = now_ms() - start;
+}
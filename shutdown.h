@@ -0,0 +1,24 @@
+/*******************************************************************************
+ * File: shutdown.h
+ * Description: Shutdown engine used by the exit built in. Background jobs are
+ * 				asked to stop with SIGTERM, given until a deadline to exit, and
+ * 				only the ones still running after that are sent SIGKILL.
+*******************************************************************************/
+#ifndef SHUTDOWN_INCLUDED
+#define SHUTDOWN_INCLUDED 1
+
+#include "vec.h"
+
+// Struct for reporting what happened to the jobs
+struct ShutdownReport
+{
+	int jobs; // Background jobs at shutdown
+	int exited; // Exited on their own or after SIGTERM
+	int killed; // Still running at the deadline and sent SIGKILL
+	int lost; // Could not be reaped even after SIGKILL
+	long elapsedMs;
+};
+
+void shutdown_jobs(PidVec *cpids, long deadlineMs, struct ShutdownReport *report);
+
+#endif
@@ -11,6 +11,7 @@
  * 				SIGTSTP - will toggle foreground only mode and normal mode.
 *******************************************************************************/
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -22,40 +23,113 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
-#include "dynArray.h"
+#include <sys/resource.h>
+#include "vec.h"
+#include "history.h"
+#include "lineedit.h"
+#include "pathtrie.h"
+#include "shutdown.h"
+#include "output.h"
+#include "timers.h"
+#include "placement.h"
+#include "envstore.h"
+#include "batch.h"
+#include "fastcopy.h"
+#include "heredoc.h"
+#include "statuspage.h"
+#include "watch.h"
+#include "journal.h"
+#include "fanout.h"
+#include "coproc.h"
+#include "cgroup.h"
+#include "memo.h"
+#include "jobstate.h"
+#include "ioring.h"
 
 // Constants
-#define MAX_ARGS 513
 #define MAX_INPUT 2048
-#define NUM_BLT_INS 3
+#define NUM_BLT_INS 8
+#define MAX_SINKS 16 // Sinks after |>
+#define HISTORY_FILE ".smallsh_history"
+#define EXIT_TIMEOUT_MS 2000 // Default time background jobs get to exit
 
 // Globals
-char *BUILT_INS[NUM_BLT_INS] = {"exit", "cd", "status"};
+char *BUILT_INS[NUM_BLT_INS] = {"exit", "cd", "status", "history", "export", "unset",
+	"watch", "coproc"};
 bool IS_FOREGROUND_ONLY = false;
+volatile sig_atomic_t COPY_INTERRUPTED = 0; // Set by CTRL-C during cat or cp
+int DEV_NULL_FDS[2] = {-1, -1}; // Kept open for background jobs' stdin and stdout
 
 // Struct for holding exit/termination status
 struct Status
 {
 	int exitStatus;
 	int termStatus;
+	bool timedOut; // Signaled because its deadline passed
+};
+
+// Struct for options given by prefixes such as timeout
+struct JobOptions
+{
+	long timeoutMs; // 0 for no deadline
+	int timeoutSignal;
+	struct Placement placement;
+	struct CgroupLimits limits;
+	ArgVec assignments; // NAME=value words before the command
+	int stdinFd; // Here-document body, or -1
+	int stdoutFd; // Pipe to a fan-out, or -1
+	int stderrFd; // Pipe to memo, or -1
+	bool hasPrefix; // timeout, pin or limit was given
 };
 
 // Prototypes
 bool is_empty(char *command);
-void parse_args_to_arr(char *line, char *arguments[], int *numArgs);
+void parse_args_to_arr(char *line, ArgVec *args);
 void free_args_memory(char *arguments[], int numArgs);
 bool is_built_in(char *command);
-void execute_built_in(char *arguments[], DynArr *cpids, struct Status lastStatus);
-void my_exit(DynArr *cpids);
+void execute_built_in(char *arguments[], PidVec *cpids, struct Status lastStatus);
+void my_exit(PidVec *cpids);
 void my_cd(char *path);
 void my_status(struct Status lastStatus);
+void my_history(char *count);
+void my_export(char *arguments[]);
+void my_unset(char *arguments[]);
+void start_history(bool isInteractive);
+bool expand_history(char **line, size_t *bufferSize);
 void check_exit_status(struct Status *lastStatus, int childExitMethod);
-void execute(char *arguments[], int *numArgs, bool isBackground);
+void execute(char *arguments[], int *numArgs, bool isBackground, struct JobOptions *options);
+pid_t spawn_job(char *arguments[], int *numArgs, bool isBackground, struct JobOptions *options);
+pid_t spawn_command(char *command[], bool isBackground, int stdinFd, int stdoutFd,
+	int stderrFd);
+pid_t spawn_watched(char *command[]);
+pid_t spawn_coproc(char *command[], int stdinFd, int stdoutFd);
+pid_t spawn_memoized(char *command[], int stdinFd, int stdoutFd, int stderrFd);
+bool wait_foreground(pid_t pid, int *childExitMethod);
+void run_fanout(char *arguments[], int *numArgs, struct JobOptions *options,
+	struct Status *lastStatus);
+void run_memo(char *arguments[], int *numArgs, struct JobOptions *options,
+	struct Status *lastStatus);
 void check_for_redirect(char *arguments[], int *numArgs, bool isBackground);
+bool open_redirects(char *arguments[], int *numArgs, int *inFd, int *outFd, bool inShell);
+ssize_t read_input_line(bool isInteractive, const char *prompt, char **line, size_t *bufferSize);
+bool check_for_heredoc(char *arguments[], int *numArgs, bool isInteractive, int *stdinFd);
+bool read_heredoc_body(int fd, char *delimiter, bool stripTabs, bool isInteractive);
+bool is_copy_command(char *arguments[], int numArgs, struct JobOptions *options);
+int my_copy(char *arguments[], int *numArgs, int stdinFd);
+int my_cat(char *arguments[], int inFd, int outFd, volatile sig_atomic_t *stop);
+int my_cp(char *source, char *target, volatile sig_atomic_t *stop);
+void catch_copy_SIGINT(int signo);
 int find_symbol(char *arguments[], char *symbol);
+int find_dup_redirect(char *arguments[], char op);
 void expand_variable(char *lookIn, char *lookFor);
 bool check_for_background_command(char *arguments[], int *numArgs);
-void check_for_background_complete(DynArr *cipds);
+void init_job_options(struct JobOptions *options);
+bool check_for_job_prefix(char *arguments[], int *numArgs, struct JobOptions *options);
+int parse_timeout_prefix(char *arguments[], struct JobOptions *options);
+int parse_pin_prefix(char *arguments[], struct JobOptions *options);
+int parse_limit_prefix(char *arguments[], struct JobOptions *options);
+void remove_args(char *arguments[], int *numArgs, int start, int count);
+void check_for_background_complete(PidVec *cpids);
 void catch_SIGTSTP(int signo);
 
 
@@ -69,12 +143,6 @@ void catch_SIGTSTP(int signo);
 void main()
 {
 	// Source: 3.3 Advanced User Input with getline()
-	// SIGINT Default - used by foreground child processes
-	struct sigaction SIGINT_action = {0}; // init struct to 0
-	SIGINT_action.sa_handler = SIG_DFL; // set function
-	sigfillset(&SIGINT_action.sa_mask); // fill mask with all signals
-	SIGINT_action.sa_flags = 0;
-
 	// SIGINT Ignore - used by shell and background processes
 	struct sigaction ignore_action = {0};
 	ignore_action.sa_handler = SIG_IGN;
@@ -89,18 +157,13 @@ void main()
 	sigaction(SIGINT, &ignore_action, NULL);
 	sigaction(SIGTSTP, &SIGTSTP_action, NULL);
 
-	// Set up signal set for blocking in foreground child
-	sigset_t signal_set;
-	sigemptyset(&signal_set);
-	sigaddset(&signal_set, SIGTSTP);
-
 	// Create dynamic array to store child PIDs
-	DynArr *cpids;
-	cpids = newDynArr(10);
+	PidVec cpids;
+	pid_vec_init(&cpids);
 
 
 	// Store status of last foreground process
-	struct Status lastStatus = {0, -5}; // init with exit=0
+	struct Status lastStatus = {0, -5, false}; // init with exit=0
 
 
 	// Buffer setup
@@ -109,19 +172,36 @@ void main()
 	int currChar = -5;
 	size_t bufferSize = 0;
 	char *lineEntered = NULL;
+
+	// Use the line editor and history when a person is at the terminal
+	bool isInteractive = line_edit_usable();
+	start_history(isInteractive);
+
+	// Publish running jobs for monitors if SMALLSH_STATUS_PAGE is set
+	status_page_open();
+
+	// Log each command's timing and resource usage if SMALLSH_JOURNAL is set
+	journal_open();
+
+	// Keep background jobs in SMALLSH_JOB_STATE, taking back any left running
+	jobstate_open(&cpids);
+
+	// Keep enforcing job deadlines while the prompt waits for the user
+	line_edit_watch(timer_fd(), timer_expire);
 	
 	// Main shell loop
 	while(1)
 	{
+		// Signal any jobs whose deadline passed since the last loop
+		timer_expire();
+
 		// Will display PIDs of background processes completed since last loop
-		check_for_background_complete(cpids);
+		check_for_background_complete(&cpids);
 
 		// Get input
 		do
 		{
-			printf(": ");
-			fflush(stdout);
-			numCharsEntered = getline(&lineEntered, &bufferSize, stdin);
+			numCharsEntered = read_input_line(isInteractive, ": ", &lineEntered, &bufferSize);
 			
 			if (numCharsEntered == -1) // getline returns -1 if interrupted
 			{	
@@ -132,115 +212,532 @@ void main()
 			{
 				free(lineEntered);
 				lineEntered = NULL;
-				printf("Error - exceeded max input\n");
-				fflush(stdout);
+				out_printf("Error - exceeded max input\n");
 			}
 		// Keep getting input if line is empty or comment
 		} while (lineEntered == NULL || is_empty(lineEntered));
+
+		// Recall !prefix from history, then record the line
+		if (!expand_history(&lineEntered, &bufferSize))
+		{
+			free(lineEntered);
+			lineEntered = NULL;
+			continue;
+		}
+		history_add(lineEntered);
 		
 
 		// Expand $$ to PID
 		expand_variable(lineEntered, "$$");
 		
 
-		// Handle args
-		char *arguments[MAX_ARGS]; // Array to store arguments
-		int numArgs = 0;
-		parse_args_to_arr(lineEntered, arguments, &numArgs);
+		// Handle args; they are only removed from here on, so items stays put
+		ArgVec args;
+		parse_args_to_arr(lineEntered, &args);
+		char **arguments = args.items;
+
+
+		// Read the bodies of any here-documents, which follow the line
+		int heredocFd;
+		bool heredocRead = check_for_heredoc(arguments, &args.size, isInteractive, &heredocFd);
+
+		// Strip prefixes such as timeout and VAR=value, which report their own errors.
+		// A failed here-document aborts the line, so its assignments are not made
+		struct JobOptions options;
+		bool hasCommand = false;
+		if (heredocRead)
+			hasCommand = check_for_job_prefix(arguments, &args.size, &options);
+		else
+			init_job_options(&options);
+		options.stdinFd = heredocFd;
+		if (!heredocRead || !hasCommand)
+		{
+			// Nothing to run
+		}
+
+		// Send the output of a command to several sinks
+		else if (find_symbol(arguments, "|>") >= 0)
+		{
+			run_fanout(arguments, &args.size, &options, &lastStatus);
+		}
+
+		// Builtins run in the shell, where prefixes and assignments cannot apply
+		else if ((options.hasPrefix || options.assignments.size > 0) &&
+			(is_built_in(arguments[0]) || strcmp(arguments[0], "memo") == 0))
+		{
+			out_printf("%s: builtins take no prefixes or assignments\n", arguments[0]);
+		}
 
+		// Replay or run and store a command's result, updating status like one
+		else if (strcmp(arguments[0], "memo") == 0)
+		{
+			run_memo(arguments, &args.size, &options, &lastStatus);
+		}
 
 		// Check for built in commands
-		if(is_built_in(arguments[0]))
+		else if(is_built_in(arguments[0]))
+		{
+			execute_built_in(arguments, &cpids, lastStatus);
+		}
+
+		// Copy in the shell for plain cat and cp, updating status like a command
+		else if (is_copy_command(arguments, args.size, &options))
 		{
-			execute_built_in(arguments, cpids, lastStatus);
+			int result = my_copy(arguments, &args.size, options.stdinFd);
+			lastStatus.timedOut = false;
+			if (result >= 0)
+			{
+				lastStatus.exitStatus = result;
+				lastStatus.termStatus = -100;
+			}
+			else
+			{
+				lastStatus.termStatus = -result;
+				lastStatus.exitStatus = -100;
+				my_status(lastStatus);
+			}
+			status_page_last(lastStatus.exitStatus, lastStatus.termStatus, false);
 		}
 
 		// Otherwise use command execution
 		else
 		{
-			pid_t spawnPid = -5;
 			int childExitMethod = -5;
 			bool isBackground = false;
 			
 			// Check global state to see if background needs to be ignored
 			if (IS_FOREGROUND_ONLY)
-				check_for_background_command(arguments, &numArgs); // To remove &
+				check_for_background_command(arguments, &args.size); // To remove &
 			else
-				isBackground = check_for_background_command(arguments, &numArgs);
+				isBackground = check_for_background_command(arguments, &args.size);
 
+			pid_t spawnPid = spawn_job(arguments, &args.size, isBackground, &options);
 
-			// Create fork
-			spawnPid = fork();
-			switch (spawnPid)
+			// Run in background
+			if (isBackground)
 			{
-				// ERROR in fork
-				case -1:
-					perror("Unable to create fork");
-					exit(1);
-					break;
-
-				// Child
-				case 0:
-					// Foreground process only
-					if (!isBackground)
-					{
-						sigaction(SIGINT, &SIGINT_action, NULL); // Set SIGINT to default
-					}
-
-					// All child ignore SIGTSP
-					sigaction(SIGTSTP, &ignore_action, NULL);
-
-					execute(arguments, &numArgs, isBackground);
-					break;
+				// Track child pid and don't wait
+				pid_vec_push(&cpids, spawnPid);
+				out_printf("background pid is %d\n", spawnPid);
+			}
+
+			// Run in foreground
+			else
+			{
+				// Wait for child, enforcing deadlines, and then update status
+				bool timedOut = wait_foreground(spawnPid, &childExitMethod);
+			
+				// Update status
+				check_exit_status(&lastStatus, childExitMethod);
+				lastStatus.timedOut = timedOut;
+				status_page_last(lastStatus.exitStatus, lastStatus.termStatus,
+					lastStatus.timedOut);
 				
-				// Parent
-				default:
-
-					// Run in background
-					if (isBackground)
-					{
-						// Track child pid and don't wait
-						addDynArr(cpids, spawnPid);
-						printf("background pid is %d\n", spawnPid);
-						fflush(stdout);
-					}
-
-					// Run in foreground
-					else
-					{
-						
-						sigprocmask(SIG_BLOCK, &signal_set, NULL); // Block SIGTSTP
-						
-						// Wait for child and then update status
-						int result;
-						do
-						{
-							result = waitpid(spawnPid, &childExitMethod, 0);
-						// Reset waitpid if interrupted by system call
-						} while (result == -1 && errno == EINTR);
-
-						sigprocmask(SIG_UNBLOCK, &signal_set, NULL);
-					
-						// Update status
-						check_exit_status(&lastStatus, childExitMethod);
-						
-						// Let user know if foreground process was terminated
-						if (WIFSIGNALED(childExitMethod) != 0)
-						{
-							printf("terminated by signal %d\n", lastStatus.termStatus);
-							fflush(stdout);
-						}
-					}
+				// Let user know if foreground process was terminated
+				if (WIFSIGNALED(childExitMethod) != 0 || lastStatus.timedOut)
+				{
+					my_status(lastStatus);
+				}
 			}
 		}
 			
 		// Free memory for input
-		free_args_memory(arguments, numArgs);
+		free_args_memory(arguments, args.size);
+		arg_vec_free(&args);
+		free_args_memory(options.assignments.items, options.assignments.size);
+		arg_vec_free(&options.assignments);
+		if (options.stdinFd != -1)
+			close(options.stdinFd);
 		free(lineEntered);
 		lineEntered = NULL;
 	}
 	// Free memory for pids
-	deleteDynArr(cpids);
+	pid_vec_free(&cpids);
+}
+
+
+/*******************************************************************************
+ * Function: spawn_job(char *arguments[], int *numArgs, bool isBackground, struct JobOptions *options)
+ * Description: Takes in the user entered args, a pointer to the number of args,
+ * 				a Boolean that is a flag for background processes and the job's
+ * 				options. Forks a child that sets up its signals, process group
+ * 				and placement and then executes the command. In the shell the
+ * 				job is published and given its deadline. Returns the child's
+ * 				pid without waiting for it.
+*******************************************************************************/
+pid_t spawn_job(char *arguments[], int *numArgs, bool isBackground, struct JobOptions *options)
+{
+	// SIGINT Default - used by foreground child processes
+	struct sigaction SIGINT_action = {0}; // init struct to 0
+	SIGINT_action.sa_handler = SIG_DFL; // set function
+	sigfillset(&SIGINT_action.sa_mask); // fill mask with all signals
+	SIGINT_action.sa_flags = 0;
+
+	// Ignore - used by all children for SIGTSTP
+	struct sigaction ignore_action = {0};
+	ignore_action.sa_handler = SIG_IGN;
+
+	// Background jobs pick up the shell's placement settings
+	if (isBackground)
+		placement_background_defaults(&options->placement);
+
+	// Apply PATH changes to the command trie before the child uses it
+	path_trie_sync();
+
+	// Flatten the environment here so the cached envp outlives the child
+	env_block();
+
+	// A limit prefix gets its cgroup before the fork, so the child is in it
+	// before exec
+	char *cgroupPath = NULL;
+	int cgroupFd = options->limits.enabled ? cgroup_prepare(&options->limits, &cgroupPath) : -1;
+
+	// Background children dup the shell's /dev/null rather than each opening it
+	if (isBackground && DEV_NULL_FDS[0] == -1)
+	{
+		struct IoringOpen devNull[2] = {
+			{"/dev/null", O_RDONLY | O_CLOEXEC, 0},
+			{"/dev/null", O_WRONLY | O_CLOEXEC, 0}
+		};
+		ioring_open(devNull, 2, false);
+		DEV_NULL_FDS[0] = devNull[0].fd;
+		DEV_NULL_FDS[1] = devNull[1].fd;
+	}
+
+	// Anything queued must come out before the child's output
+	out_flush();
+
+	// Create fork
+	pid_t spawnPid = fork();
+	switch (spawnPid)
+	{
+		// ERROR in fork
+		case -1:
+			perror("Unable to create fork");
+			exit(1);
+			break;
+
+		// Child
+		case 0:
+			// Foreground process only
+			if (!isBackground)
+			{
+				sigaction(SIGINT, &SIGINT_action, NULL); // Set SIGINT to default
+			}
+			// Background jobs lead their own process group
+			else
+			{
+				setpgid(0, 0);
+			}
+
+			// All child ignore SIGTSP
+			sigaction(SIGTSTP, &ignore_action, NULL);
+
+			// CPU affinity, nice level and scheduling policy
+			placement_apply(&options->placement);
+			if (cgroupFd != -1)
+				cgroup_join(cgroupFd);
+
+			execute(arguments, numArgs, isBackground, options);
+			break;
+		
+		// Parent
+		default:
+			status_page_add(spawnPid, arguments, isBackground);
+			journal_start(spawnPid, arguments, isBackground);
+			if (cgroupFd != -1)
+				cgroup_track(spawnPid, cgroupFd, cgroupPath);
+			if (options->timeoutMs > 0)
+				timer_add(spawnPid, options->timeoutMs, options->timeoutSignal);
+
+			// Set the group here too so it exists before any kill
+			if (isBackground)
+			{
+				setpgid(spawnPid, spawnPid);
+				jobstate_add(spawnPid, arguments);
+			}
+	}
+	return spawnPid;
+}
+
+
+/*******************************************************************************
+ * Function: spawn_command(char *command[], bool isBackground, int stdinFd,
+ * 				int stdoutFd, int stderrFd)
+ * Description: Takes in a NULL terminated command given to a builtin such as
+ * 				watch, whether it runs in the background and fds for its
+ * 				stdin, stdout and stderr, -1 to leave one alone. Starts it on a
+ * 				copy of the args, so prefixes such as timeout can be stripped
+ * 				each time. Returns its pid, or -1 if there was nothing to run.
+*******************************************************************************/
+pid_t spawn_command(char *command[], bool isBackground, int stdinFd, int stdoutFd,
+	int stderrFd)
+{
+	ArgVec args;
+	arg_vec_init(&args);
+	for (int i = 0; command[i] != NULL; i++)
+		arg_vec_push(&args, strdup(command[i]));
+	arg_vec_push(&args, NULL);
+	args.size--;
+
+	pid_t spawnPid = -1;
+	struct JobOptions options;
+	if (check_for_job_prefix(args.items, &args.size, &options))
+	{
+		options.stdinFd = stdinFd;
+		options.stdoutFd = stdoutFd;
+		options.stderrFd = stderrFd;
+		spawnPid = spawn_job(args.items, &args.size, isBackground, &options);
+	}
+
+	free_args_memory(args.items, args.size);
+	arg_vec_free(&args);
+	free_args_memory(options.assignments.items, options.assignments.size);
+	arg_vec_free(&options.assignments);
+	return spawnPid;
+}
+
+
+/*******************************************************************************
+ * Function: spawn_watched(char *command[])
+ * Description: Starts a command for the watch builtin in the foreground.
+*******************************************************************************/
+pid_t spawn_watched(char *command[])
+{
+	return spawn_command(command, false, -1, -1, -1);
+}
+
+
+/*******************************************************************************
+ * Function: spawn_coproc(char *command[], int stdinFd, int stdoutFd)
+ * Description: Starts a command for the coproc builtin in the background on
+ * 				the pipe ends for its stdin and stdout.
+*******************************************************************************/
+pid_t spawn_coproc(char *command[], int stdinFd, int stdoutFd)
+{
+	return spawn_command(command, true, stdinFd, stdoutFd, -1);
+}
+
+
+/*******************************************************************************
+ * Function: spawn_memoized(char *command[], int stdinFd, int stdoutFd, int stderrFd)
+ * Description: Starts a command for the memo builtin in the foreground with
+ * 				its output going to memo's pipes.
+*******************************************************************************/
+pid_t spawn_memoized(char *command[], int stdinFd, int stdoutFd, int stderrFd)
+{
+	return spawn_command(command, false, stdinFd, stdoutFd, stderrFd);
+}
+
+
+/*******************************************************************************
+ * Function: wait_foreground(pid_t pid, int *childExitMethod)
+ * Description: Takes in a foreground job's pid and where to store how it
+ * 				ended. Waits for it with SIGTSTP held off, enforcing deadlines,
+ * 				then clears the shell's records of it. Returns true if it was
+ * 				signaled because its deadline passed.
+*******************************************************************************/
+bool wait_foreground(pid_t pid, int *childExitMethod)
+{
+	// Set up signal set for blocking in foreground child
+	sigset_t signal_set;
+	sigemptyset(&signal_set);
+	sigaddset(&signal_set, SIGTSTP);
+
+	struct rusage usage;
+	sigprocmask(SIG_BLOCK, &signal_set, NULL); // Block SIGTSTP
+	timer_wait_child(pid, childExitMethod, &usage);
+	timer_cancel(pid);
+	sigprocmask(SIG_UNBLOCK, &signal_set, NULL);
+
+	status_page_remove(pid);
+	cgroup_reaped(pid);
+	journal_end(pid, *childExitMethod, &usage);
+	return timer_take_timeout(pid);
+}
+
+
+/*******************************************************************************
+ * Function: split_sinks(char *arguments[], int start, ArgVec sinks[], int *numSinks)
+ * Description: Takes in the args, where the sinks after |> begin, and an array
+ * 				of MAX_SINKS vectors. Copies the words of each comma separated
+ * 				sink into its own NULL terminated vector. A comma may stand
+ * 				alone or end a word. Returns false, displaying a message, if a
+ * 				sink is empty or there are too many.
+*******************************************************************************/
+bool split_sinks(char *arguments[], int start, ArgVec sinks[], int *numSinks)
+{
+	*numSinks = 0;
+	bool ended = true; // The next word starts a new sink
+	bool ok = true;
+	for (int i = start; arguments[i] != NULL && ok; i++)
+	{
+		if (ended && *numSinks == MAX_SINKS)
+		{
+			out_printf("|>: too many sinks\n");
+			return false;
+		}
+		if (ended)
+			arg_vec_init(&sinks[(*numSinks)++]);
+		ArgVec *sink = &sinks[*numSinks - 1];
+
+		size_t len = strlen(arguments[i]);
+		ended = arguments[i][len-1] == ',';
+		if (len > 1 || !ended)
+			arg_vec_push(sink, strndup(arguments[i], ended ? len - 1 : len));
+		ok = sink->size > 0;
+	}
+
+	for (int i = 0; i < *numSinks; i++)
+	{
+		arg_vec_push(&sinks[i], NULL);
+		sinks[i].size--;
+	}
+	if (!ok || ended)
+		out_printf("|>: missing sink\n");
+	return ok && !ended;
+}
+
+
+/*******************************************************************************
+ * Function: run_fanout(char *arguments[], int *numArgs, struct JobOptions *options,
+ * 				struct Status *lastStatus)
+ * Description: Runs command |> sink, sink... in the foreground. Each sink is a
+ * 				command that reads the output on its stdin, or > FILE or
+ * 				>> FILE for the shell to write. The producer and the sink
+ * 				commands are started like any foreground command, with their
+ * 				own prefixes, and the shell copies between the pipes with
+ * 				fanout_copy(). The status is the producer's, or the first
+ * 				failing sink's if the producer exited with 0. A trailing & is
+ * 				ignored.
+*******************************************************************************/
+void run_fanout(char *arguments[], int *numArgs, struct JobOptions *options,
+	struct Status *lastStatus)
+{
+	check_for_background_command(arguments, numArgs);
+	int split = find_symbol(arguments, "|>");
+	ArgVec sinkArgs[MAX_SINKS];
+	struct JobOptions sinkOptions[MAX_SINKS];
+	int sinkFds[MAX_SINKS];
+	pid_t sinkPids[MAX_SINKS];
+	int numSinks = 0;
+
+	// Check everything before anything is started
+	bool ok = split > 0 && find_symbol(&arguments[split+1], "|>") < 0;
+	if (!ok)
+		out_printf("|>: %s\n", (split == 0) ? "missing command" : "only one |> is supported");
+	ok = ok && split_sinks(arguments, split + 1, sinkArgs, &numSinks);
+	remove_args(arguments, numArgs, split, *numArgs - split);
+
+	for (int i = 0; i < numSinks; i++)
+	{
+		sinkFds[i] = -1;
+		sinkPids[i] = -1;
+		arg_vec_init(&sinkOptions[i].assignments);
+		if (!ok)
+			continue;
+		char **words = sinkArgs[i].items;
+		bool isFile = strcmp(words[0], ">") == 0 || strcmp(words[0], ">>") == 0;
+		if (isFile && sinkArgs[i].size != 2)
+		{
+			out_printf("|>: %s needs one file\n", words[0]);
+			ok = false;
+		}
+		else if (isFile)
+		{
+			int flags = O_WRONLY | O_CREAT | O_CLOEXEC |
+				((words[0][1] == '>') ? O_APPEND : O_TRUNC);
+			sinkFds[i] = open(words[1], flags, 0644);
+			if (sinkFds[i] == -1)
+			{
+				out_printf("|>: cannot open %s: %s\n", words[1], strerror(errno));
+				ok = false;
+			}
+		}
+		else
+		{
+			ok = check_for_job_prefix(words, &sinkArgs[i].size, &sinkOptions[i]);
+		}
+	}
+
+	// Start the sinks, then the producer
+	int source[2] = {-1, -1};
+	ok = ok && pipe2(source, O_CLOEXEC) == 0;
+	for (int i = 0; i < numSinks && ok; i++)
+	{
+		int input[2];
+		if (sinkFds[i] != -1)
+			continue;
+		if (pipe2(input, O_CLOEXEC) == -1)
+		{
+			out_printf("|>: %s\n", strerror(errno));
+			ok = false;
+			break;
+		}
+		sinkOptions[i].stdinFd = input[0];
+		sinkPids[i] = spawn_job(sinkArgs[i].items, &sinkArgs[i].size, false, &sinkOptions[i]);
+		close(input[0]);
+		sinkFds[i] = input[1];
+	}
+
+	pid_t producer = -1;
+	if (ok)
+	{
+		options->stdoutFd = source[1];
+		producer = spawn_job(arguments, numArgs, false, options);
+		close(source[1]);
+		options->stdoutFd = -1;
+		fanout_copy(source[0], sinkFds, numSinks, timer_fd(), timer_expire);
+	}
+	else if (source[1] != -1)
+	{
+		close(source[1]);
+	}
+
+	// The sinks see end of file, and a producer still writing gets SIGPIPE
+	if (source[0] != -1)
+		close(source[0]);
+	for (int i = 0; i < numSinks; i++)
+	{
+		if (sinkFds[i] != -1)
+			close(sinkFds[i]);
+	}
+
+	// Status of the producer, or of the first sink to fail
+	int childExitMethod = 0;
+	bool timedOut = false;
+	if (producer > 0)
+		timedOut = wait_foreground(producer, &childExitMethod);
+
+	// A producer stopped by SIGPIPE only outlived its sinks
+	if (!timedOut && WIFSIGNALED(childExitMethod) && WTERMSIG(childExitMethod) == SIGPIPE)
+		childExitMethod = 0;
+	for (int i = 0; i < numSinks; i++)
+	{
+		int sinkExitMethod;
+		bool sinkTimedOut = false;
+		if (sinkPids[i] > 0)
+			sinkTimedOut = wait_foreground(sinkPids[i], &sinkExitMethod);
+		if (sinkPids[i] > 0 && childExitMethod == 0 && !timedOut &&
+			(sinkExitMethod != 0 || sinkTimedOut))
+		{
+			childExitMethod = sinkExitMethod;
+			timedOut = sinkTimedOut;
+		}
+		free_args_memory(sinkArgs[i].items, sinkArgs[i].size);
+		arg_vec_free(&sinkArgs[i]);
+		free_args_memory(sinkOptions[i].assignments.items, sinkOptions[i].assignments.size);
+		arg_vec_free(&sinkOptions[i].assignments);
+	}
+
+	if (producer > 0)
+	{
+		check_exit_status(lastStatus, childExitMethod);
+		lastStatus->timedOut = timedOut;
+		status_page_last(lastStatus->exitStatus, lastStatus->termStatus, timedOut);
+		if (WIFSIGNALED(childExitMethod) != 0 || timedOut)
+			my_status(*lastStatus);
+	}
 }
 
 
@@ -248,276 +745,1086 @@ void main()
  * Function: catchSIGTSTP(int signo)
  * Description: Signal handler function for SIGTSTP when user enters CTRL-Z. It
  * 				toggles the global variable IS_FOREGROUND_ONLY to change the 
- * 				mode of the shell. Also displays a message to the user.
+ * 				mode of the shell. Also displays a message to the user. The
+ * 				message is written directly since only write() is safe in a
+ * 				signal handler; the output queue is always flushed before the
+ * 				shell waits, so it cannot overtake queued messages.
 *******************************************************************************/
 void catch_SIGTSTP(int signo)
 {
 	// In foreground only mode
 	if (IS_FOREGROUND_ONLY)
 	{
-		char *message = "Exiting foreground-only mode\n";
-		write(STDOUT_FILENO, message, 29);
+		static const char message[] = "Exiting foreground-only mode\n";
+		write(STDOUT_FILENO, message, sizeof(message) - 1);
 		IS_FOREGROUND_ONLY = false;
 	}
 	// In normal mode
 	else
 	{
-		char *message = "Entering foreground-only mode (& is now ignored)\n";
-		write(STDOUT_FILENO, message, 49);
-		IS_FOREGROUND_ONLY = true;
+		static const char message[] = "Entering foreground-only mode (& is now ignored)\n";
+		write(STDOUT_FILENO, message, sizeof(message) - 1);
+		IS_FOREGROUND_ONLY = true;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: run_memo(char *arguments[], int *numArgs, struct JobOptions *options,
+ * 				struct Status *lastStatus)
+ * Description: Takes in the args of a memo command, its options and the last
+ * 				status. Sets up its redirections, which memo applies to the
+ * 				replayed or captured output rather than the command, runs it
+ * 				and updates the status like a foreground command.
+********************************************************************************/
+void run_memo(char *arguments[], int *numArgs, struct JobOptions *options,
+	struct Status *lastStatus)
+{
+	check_for_background_command(arguments, numArgs);
+	int inFd, outFd;
+	if (!open_redirects(arguments, numArgs, &inFd, &outFd, true))
+		return;
+	if (inFd == -1 && options->stdinFd != -1)
+		inFd = dup(options->stdinFd);
+
+	struct MemoRunner runner = {spawn_memoized, wait_foreground, timer_fd(), timer_expire};
+	int childExitMethod = -5;
+	bool timedOut;
+	if (memo_run(arguments, inFd, (outFd != -1) ? outFd : 1, &runner, &childExitMethod,
+		&timedOut))
+	{
+		check_exit_status(lastStatus, childExitMethod);
+		lastStatus->timedOut = timedOut;
+		status_page_last(lastStatus->exitStatus, lastStatus->termStatus,
+			lastStatus->timedOut);
+		if (WIFSIGNALED(childExitMethod) != 0 || timedOut)
+			my_status(*lastStatus);
+	}
+
+	ioring_close(inFd);
+	ioring_close(outFd);
+	ioring_flush();
+}
+
+
+/*******************************************************************************
+ * Function: check_for_background_complete(PidVec *cpids)
+ * Description: Takes in an array of the background child process pids. Loops
+ * 				through them to see if any of them have terminated. If they have
+ * 				they are removed from the array and a message is displayed to 
+ * 				the user. The pids still running are packed down in one pass,
+ * 				so they keep their order.
+********************************************************************************/
+void check_for_background_complete(PidVec *cpids)
+{
+	int kept = 0; // Pids still running, moved to the front
+
+	for (int i = 0; i < cpids->size; i++)
+	{
+		// Check if each process has completed
+		int childExitMethod = -5;
+		struct rusage usage;
+		int result;
+		result = wait4(cpids->items[i], &childExitMethod, WNOHANG, &usage);
+
+		// An adopted job that is not a child can only be seen to have gone
+		bool isUnknown = false;
+		if (result == -1 && errno == ECHILD && jobstate_gone(cpids->items[i]))
+		{
+			result = cpids->items[i];
+			isUnknown = true;
+			memset(&usage, 0, sizeof(usage));
+		}
+
+		// Keep it if it has not completed
+		if (result <= 0)
+		{
+			cpids->items[kept++] = cpids->items[i];
+		}
+		else
+		{
+			// Print either exit status or termination signal
+			timer_cancel(result);
+			status_page_remove(result);
+			cgroup_reaped(result);
+			journal_end(result, childExitMethod, &usage);
+			coproc_reaped(result);
+			jobstate_remove(result);
+			out_printf("background pid %d is done: ", result);
+			if (timer_take_timeout(result))
+				out_printf("timed out, ");
+			if (isUnknown)
+				out_printf("exit value unknown\n");
+			else if (WIFEXITED(childExitMethod) != 0)
+				out_printf("exit value %d\n", WEXITSTATUS(childExitMethod));
+			else if (WIFSIGNALED(childExitMethod) != 0)
+				out_printf("terminated by signal %d\n", WTERMSIG(childExitMethod));
+		}
+	}
+	cpids->size = kept;
+
+	// Processes reparented to the shell as their subreaper
+	jobstate_reap_strays(cpids);
+}
+
+
+/*******************************************************************************
+ * Function: check_for_background_command(char *arguments[], int *numArgs)
+ * Description: Takes in an array of strings that represent the user entered
+ * 				args and a pointer to the number of args in the array. It looks
+ * 				up the last position of the array and compartes it to "&" to 
+ * 				check if this command is meant to be a background command. Will
+ * 				NULL out the & and return true if found, otherwise returns false.
+********************************************************************************/
+bool check_for_background_command(char *arguments[], int *numArgs)
+{
+	// Look at last arg in list to see if it is &
+	if (strcmp(arguments[(*numArgs)-1], "&") == 0)
+	{
+		// Free the memory for &
+		free(arguments[(*numArgs)-1]);
+		arguments[(*numArgs)-1] = NULL;
+		(*numArgs)--; // Update numArgs
+
+		return true;
+	}
+	// Not background command
+	return false;
+}
+
+
+/*******************************************************************************
+ * Function: remove_args(char *arguments[], int *numArgs, int start, int count)
+ * Description: Takes in the arguments array, a pointer to its size, and a range
+ * 				of arguments. Frees the arguments in the range and shifts the
+ * 				rest down to fill the gap, keeping the array NULL terminated.
+********************************************************************************/
+void remove_args(char *arguments[], int *numArgs, int start, int count)
+{
+	for (int i = start; i < start + count; i++)
+		free(arguments[i]);
+
+	for (int i = start; i + count <= *numArgs; i++)
+		arguments[i] = arguments[i + count];
+	(*numArgs) -= count;
+}
+
+
+/*******************************************************************************
+ * Function: parse_timeout_prefix(char *arguments[], struct JobOptions *options)
+ * Description: Takes in args starting with a timeout prefix and the options to
+ * 				fill in:
+ * 					timeout [-s SIGNAL] DURATION command...
+ * 				Returns the number of args the prefix used, or -1 after
+ * 				displaying a message if it is malformed.
+********************************************************************************/
+int parse_timeout_prefix(char *arguments[], struct JobOptions *options)
+{
+	int used = 1;
+
+	// Optional signal to send instead of the default
+	if (arguments[used] != NULL && strcmp(arguments[used], "-s") == 0)
+	{
+		if (arguments[used+1] == NULL || parse_signal(arguments[used+1]) == -1)
+		{
+			out_printf("timeout: invalid signal %s\n",
+				arguments[used+1] != NULL ? arguments[used+1] : "");
+			return -1;
+		}
+		options->timeoutSignal = parse_signal(arguments[used+1]);
+		used += 2;
+	}
+
+	if (arguments[used] == NULL || parse_duration(arguments[used]) == -1)
+	{
+		out_printf("usage: timeout [-s SIGNAL] DURATION command\n");
+		return -1;
+	}
+	options->timeoutMs = parse_duration(arguments[used]);
+	return used + 1;
+}
+
+
+/*******************************************************************************
+ * Function: parse_pin_prefix(char *arguments[], struct JobOptions *options)
+ * Description: Takes in args starting with a pin prefix and the options to
+ * 				fill in:
+ * 					pin [-n NICE] [-b] CPUSET command...
+ * 				where CPUSET is a list such as 0-3,6, NICE is from -20 to 19 and
+ * 				-b selects SCHED_BATCH. Returns the number of args the prefix used, or -1 after
+ * 				displaying a message if it is malformed.
+********************************************************************************/
+int parse_pin_prefix(char *arguments[], struct JobOptions *options)
+{
+	struct Placement *placement = &options->placement;
+	int used = 1;
+
+	while (arguments[used] != NULL && arguments[used][0] == '-')
+	{
+		if (strcmp(arguments[used], "-b") == 0)
+		{
+			placement->batch = true;
+			used++;
+		}
+		else if (strcmp(arguments[used], "-n") == 0 && arguments[used+1] != NULL &&
+			parse_nice(arguments[used+1], &placement->nice))
+		{
+			placement->hasNice = true;
+			used += 2;
+		}
+		else if (strcmp(arguments[used], "-n") == 0)
+		{
+			out_printf("usage: pin [-n NICE] [-b] CPUSET command\n");
+			return -1;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (arguments[used] == NULL || !parse_cpuset(arguments[used], &placement->cpus))
+	{
+		out_printf("usage: pin [-n NICE] [-b] CPUSET command\n");
+		return -1;
+	}
+	placement->hasCpus = true;
+	return used + 1;
+}
+
+
+/*******************************************************************************
+ * Function: parse_limit_prefix(char *arguments[], struct JobOptions *options)
+ * Description: Takes in args starting with a limit prefix and the options to
+ * 				fill in:
+ * 					limit [-m MEM] [-c CPUS] [-p PIDS] command...
+ * 				With no flags the job still gets a cgroup for its accounting.
+ * 				Returns the number of args the prefix used, or -1 after
+ * 				displaying a message if it is malformed.
+********************************************************************************/
+int parse_limit_prefix(char *arguments[], struct JobOptions *options)
+{
+	struct CgroupLimits *limits = &options->limits;
+	int used = 1;
+	bool ok = true;
+
+	while (ok && arguments[used] != NULL && arguments[used][0] == '-')
+	{
+		char *value = arguments[used+1];
+		if (value == NULL)
+			ok = false;
+		else if (strcmp(arguments[used], "-m") == 0)
+			ok = parse_memory_size(value, &limits->memoryMax);
+		else if (strcmp(arguments[used], "-c") == 0)
+			ok = parse_cpu_quota(value, &limits->cpuQuotaUs);
+		else if (strcmp(arguments[used], "-p") == 0)
+		{
+			limits->pidsMax = atoll(value);
+			ok = limits->pidsMax > 0;
+		}
+		else
+			ok = false;
+		used += 2;
+	}
+
+	if (!ok)
+	{
+		out_printf("usage: limit [-m MEM] [-c CPUS] [-p PIDS] command\n");
+		return -1;
+	}
+	limits->enabled = true;
+	return used;
+}
+
+
+/*******************************************************************************
+ * Function: init_job_options(struct JobOptions *options)
+ * Description: Sets options to run a command as is, with no prefixes, no
+ * 				assignments and the shell's own standard streams.
+*******************************************************************************/
+void init_job_options(struct JobOptions *options)
+{
+	memset(options, 0, sizeof(struct JobOptions));
+	arg_vec_init(&options->assignments);
+	options->timeoutSignal = SIGTERM;
+	options->stdinFd = -1;
+	options->stdoutFd = -1;
+	options->stderrFd = -1;
+}
+
+
+/*******************************************************************************
+ * Function: check_for_job_prefix(char *arguments[], int *numArgs, struct JobOptions *options)
+ * Description: Takes in the user entered args, a pointer to the number of args
+ * 				and the options to fill in. Options start from the shell
+ * 				defaults (SMALLSH_TIMEOUT and SMALLSH_TIMEOUT_SIGNAL), then each
+ * 				leading prefix (timeout, pin, limit) is applied and removed from the
+ * 				args. Leading NAME=value words are moved into the options for
+ * 				the command's environment; if there is no command they set
+ * 				shell variables instead. Returns false if there is no command
+ * 				to run, displaying a message if that is because a prefix was
+ * 				malformed.
+********************************************************************************/
+bool check_for_job_prefix(char *arguments[], int *numArgs, struct JobOptions *options)
+{
+	// Shell-wide defaults
+	init_job_options(options);
+	const char *defaultTimeout = env_get("SMALLSH_TIMEOUT");
+	const char *defaultSignal = env_get("SMALLSH_TIMEOUT_SIGNAL");
+	if (defaultTimeout != NULL && parse_duration(defaultTimeout) > 0)
+		options->timeoutMs = parse_duration(defaultTimeout);
+	if (defaultSignal != NULL && parse_signal(defaultSignal) > 0)
+		options->timeoutSignal = parse_signal(defaultSignal);
+
+	char *lastPrefix = NULL;
+	while (*numArgs > 0)
+	{
+		// Keep assignments for the command's environment
+		if (env_is_assignment(arguments[0]))
+		{
+			arg_vec_push(&options->assignments, arguments[0]);
+			arguments[0] = NULL;
+			remove_args(arguments, numArgs, 0, 1);
+			continue;
+		}
+
+		int used;
+		if (strcmp(arguments[0], "timeout") == 0)
+		{
+			used = parse_timeout_prefix(arguments, options);
+			lastPrefix = "timeout";
+		}
+		else if (strcmp(arguments[0], "pin") == 0)
+		{
+			used = parse_pin_prefix(arguments, options);
+			lastPrefix = "pin";
+		}
+		else if (strcmp(arguments[0], "limit") == 0)
+		{
+			used = parse_limit_prefix(arguments, options);
+			lastPrefix = "limit";
+		}
+		else
+			break;
+
+		if (used == -1)
+			return false;
+		remove_args(arguments, numArgs, 0, used);
+	}
+
+	// A line of only spaces, or a prefix with nothing after it
+	if (*numArgs == 0)
+	{
+		if (lastPrefix != NULL)
+			out_printf("%s: missing command\n", lastPrefix);
+		else
+		{
+			for (int i = 0; i < options->assignments.size; i++)
+				env_put(options->assignments.items[i]);
+		}
+		return false;
+	}
+	options->hasPrefix = lastPrefix != NULL;
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: expand_variables(char *lookIn, char *lookFor)
+ * Source: stackoverflow.com/questions/32413667
+ * Description: Takes in a string to look in and a string to look for. Uses 
+ * 				strstr to look for occurances of the lookFor sting inside of the
+ * 				lookIn string. If found, the loofFor portion is removed and 
+ * 				replaces by the PID of the process.
+********************************************************************************/
+void expand_variable(char *lookIn, char *lookFor)
+{	
+	// Get PID and convert to string
+	int pid = getpid();
+	char strPID[8];
+	snprintf(strPID, sizeof(strPID), "%d", pid);
+		
+	char buffer[2100] = { 0 }; // For piecing string back together
+	char *tmpLookIn = lookIn; // For traversing lookIn string
+
+	// Keep going until all lookFors are converted
+	while((tmpLookIn = strstr(tmpLookIn, lookFor))) // Will be NULL if no matches
+	{
+		// Copy up until found lookin
+		strncpy(buffer, lookIn, tmpLookIn-lookIn);
+		buffer[tmpLookIn-lookIn] = '\0';
+		
+		// Add on the PID
+		strcat(buffer, strPID);
+
+		// Add on the rest of string, after lookFor
+		strcat(buffer, tmpLookIn+strlen(lookFor));	
+		
+		// Copy re-built string into lookIn
+		strcpy(lookIn, buffer);
+		
+		tmpLookIn++;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: find_symbol(char *arguments[], char *symbol)
+ * Description: Takes in an array of strings and a string to search for. Loops
+ * 				throught the array and if the symbol is found, its position in
+ * 				the array is returned. Other wise -10 is returned.
+********************************************************************************/
+int find_symbol(char *arguments[], char *symbol)
+{
+	int position = -10;
+	int i = 0;
+	while (arguments[i] != NULL) // Arguments last position is NULL
+	{
+		// Found the symbol in args, so return the position it is at
+		if (strcmp(arguments[i], symbol) == 0)
+		{
+			position = i;
+			break;
+		}
+		i++;
+	}
+	return position;
+}
+
+
+/*******************************************************************************
+ * Function: find_dup_redirect(char *arguments[], char op)
+ * Description: Takes in an array of strings and < or >. Returns the position
+ * 				of the first word of the form <&N or >&N for that operator,
+ * 				otherwise -10.
+********************************************************************************/
+int find_dup_redirect(char *arguments[], char op)
+{
+	for (int i = 0; arguments[i] != NULL; i++)
+	{
+		if (arguments[i][0] == op && arguments[i][1] == '&' && arguments[i][2] != '\0')
+			return i;
+	}
+	return -10;
+}
+
+
+/*******************************************************************************
+ * Function: open_redirects(char *arguments[], int *numArgs, int *inFd, int *outFd,
+ * 				bool inShell)
+ * Description: Takes in an array of arguments from the user, pointers for
+ * 				the file descriptors and whether this is the shell itself, which
+ * 				may use the io_uring engine, or a forked child. Opens the files named after < and >, or
+ * 				duplicates the fd given by <&N or >&N, where N may be $NAME,
+ * 				and removes the redirection from the args, leaving -1 for a side
+ * 				that is not redirected. The descriptors are close on exec.
+ * 				Returns false after displaying a message if a file cannot be
+ * 				opened; the output file is not created if the input fails.
+********************************************************************************/
+bool open_redirects(char *arguments[], int *numArgs, int *inFd, int *outFd, bool inShell)
+{
+	int pos1 = find_symbol(arguments, "<");	// STDIN
+	int pos2 = find_symbol(arguments, ">"); // STDOUT
+
+	// Open both files with the next args together, input first. A forked child
+	// opens them itself, as the shell's ring is not its to use
+	struct IoringOpen files[2] = {
+		{(pos1 >= 0) ? arguments[pos1+1] : NULL, O_RDONLY | O_CLOEXEC, 0},
+		{(pos2 >= 0) ? arguments[pos2+1] : NULL, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644}
+	};
+	if (inShell)
+	{
+		ioring_open(files, 2, true);
+	}
+	else
+	{
+		files[0].fd = (files[0].path != NULL) ?
+			open(files[0].path, files[0].flags, files[0].mode) : -1;
+		bool inOk = files[0].path == NULL || files[0].fd != -1;
+		files[1].fd = (files[1].path != NULL && inOk) ?
+			open(files[1].path, files[1].flags, files[1].mode) : -1;
+	}
+	*inFd = files[0].fd;
+	*outFd = files[1].fd;
+	if (pos1 >= 0 && *inFd == -1)
+	{
+		out_printf("cannont open %s for input\n", arguments[pos1+1]);
+		return false;
+	}
+	if (pos2 >= 0 && *outFd == -1)
+	{
+		out_printf("cannot open %s for output\n", arguments[pos2+1]);
+		if (inShell)
+		{
+			ioring_close(*inFd);
+			ioring_flush();
+		}
+		else if (*inFd != -1)
+		{
+			close(*inFd);
+		}
+		return false;
+	}
+
+	// >&N and <&N use an open fd, such as a coprocess's $NAME_W or $NAME_R
+	int dupPos1 = (pos1 >= 0) ? -10 : find_dup_redirect(arguments, '<');
+	int dupPos2 = (pos2 >= 0) ? -10 : find_dup_redirect(arguments, '>');
+	int dupPositions[2] = {dupPos1, dupPos2};
+	int *fds[2] = {inFd, outFd};
+	for (int i = 0; i < 2; i++)
+	{
+		if (dupPositions[i] < 0)
+			continue;
+		const char *target = arguments[dupPositions[i]] + 2;
+		if (target[0] == '$')
+			target = env_get(target + 1);
+		bool isNumber = target != NULL && target[0] != '\0' &&
+			strspn(target, "0123456789") == strlen(target);
+		*fds[i] = isNumber ? fcntl(atoi(target), F_DUPFD_CLOEXEC, 0) : -1;
+		if (*fds[i] == -1)
+		{
+			out_printf("cannot duplicate %s\n", arguments[dupPositions[i]]);
+			if (i == 1 && *inFd != -1)
+				close(*inFd);
+			return false;
+		}
+	}
+	for (int i = 0; i < 2; i++)
+	{
+		if (dupPositions[i] >= 0)
+		{
+			free(arguments[dupPositions[i]]);
+			arguments[dupPositions[i]] = NULL;
+			(*numArgs)--;
+		}
+	}
+
+	// NULL out pos so arguments will end with a NULL for exec()
+	int positions[2] = {pos1, pos2};
+	for (int i = 0; i < 2; i++)
+	{
+		if (positions[i] >= 0)
+		{
+			free(arguments[positions[i]]);
+			arguments[positions[i]] = NULL;
+			(*numArgs)--;
+
+			free(arguments[positions[i]+1]);
+			arguments[positions[i]+1] = NULL;
+			(*numArgs)--;
+		}
+	}
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: read_input_line(bool isInteractive, const char *prompt, char **line, size_t *bufferSize)
+ * Description: Takes in whether a person is using the shell, the prompt and
+ * 				the buffer to read into. Reads the next line of input with the
+ * 				line editor, or getline() for a script, where prompt may be
+ * 				NULL to display nothing. Returns the number of characters read,
+ * 				or -1 at end of input.
+********************************************************************************/
+ssize_t read_input_line(bool isInteractive, const char *prompt, char **line, size_t *bufferSize)
+{
+	if (isInteractive)
+	{
+		out_flush();
+		return line_edit_read(prompt, line, bufferSize);
+	}
+
+	// Messages from this cycle go out with the prompt in one write
+	if (prompt != NULL)
+		out_write(prompt, strlen(prompt));
+	out_flush();
+	return getline(line, bufferSize, stdin);
+}
+
+
+/*******************************************************************************
+ * Function: check_for_heredoc(char *arguments[], int *numArgs, bool isInteractive, int *stdinFd)
+ * Description: Takes in the user entered args, a pointer to the number of args,
+ * 				whether a person is using the shell and where to store the
+ * 				descriptor for stdin. Handles each redirection of the forms
+ * 					<<WORD   here-document ending at a line that is WORD
+ * 					<<-WORD  the same with leading tabs removed from each line
+ * 					<<<WORD  here-string, WORD and a newline
+ * 				reading the here-document bodies from the lines after the
+ * 				command. The bodies are taken as written, without expansion.
+ * 				Each goes into a sealed memfd and is removed from the args; the
+ * 				last one becomes stdin (-1 if there are none). Returns false
+ * 				after displaying a message if one is malformed or cannot be
+ * 				stored.
+********************************************************************************/
+bool check_for_heredoc(char *arguments[], int *numArgs, bool isInteractive, int *stdinFd)
+{
+	*stdinFd = -1;
+	bool ok = true;
+
+	int i = 0;
+	while (i < *numArgs)
+	{
+		char *arg = arguments[i];
+		if (strncmp(arg, "<<", 2) != 0)
+		{
+			i++;
+			continue;
+		}
+
+		bool isString = strncmp(arg, "<<<", 3) == 0;
+		bool stripTabs = !isString && arg[2] == '-';
+		char *word = arg + ((isString || stripTabs) ? 3 : 2);
+		int used = 1;
+
+		// The word can also be the next arg
+		if (*word == '\0')
+		{
+			if (i + 1 >= *numArgs)
+			{
+				out_printf("syntax error: missing word after %s\n", arg);
+				ok = false;
+				break;
+			}
+			word = arguments[i+1];
+			used = 2;
+		}
+
+		if (*stdinFd != -1)
+			close(*stdinFd);
+		*stdinFd = heredoc_open();
+		if (*stdinFd == -1)
+		{
+			out_printf("cannot create here-document: %s\n", strerror(errno));
+			ok = false;
+		}
+
+		if (isString)
+		{
+			if (*stdinFd != -1)
+				ok = heredoc_write(*stdinFd, word, strlen(word)) &&
+					heredoc_write(*stdinFd, "\n", 1) && ok;
+		}
+		else
+		{
+			// A quoted delimiter is matched without its quotes
+			char delimiter[MAX_INPUT+1];
+			snprintf(delimiter, sizeof(delimiter), "%s", word);
+			size_t len = strlen(delimiter);
+			if (len >= 2 && (delimiter[0] == '\'' || delimiter[0] == '"') &&
+				delimiter[len-1] == delimiter[0])
+			{
+				memmove(delimiter, delimiter + 1, len - 2);
+				delimiter[len-2] = '\0';
+			}
+			ok = read_heredoc_body(*stdinFd, delimiter, stripTabs, isInteractive) && ok;
+		}
+
+		if (*stdinFd != -1 && !heredoc_finish(*stdinFd))
+			ok = false;
+		remove_args(arguments, numArgs, i, used);
+	}
+
+	if (!ok && *stdinFd != -1)
+	{
+		close(*stdinFd);
+		*stdinFd = -1;
 	}
+	return ok;
 }
 
 
 /*******************************************************************************
- * Function: check_for_background_complete(DynArr *cpids)
- * Description: Takes in an array of the background child process pids. Loops
- * 				through them to see if any of them have terminated. If they have
- * 				they are removed from the array and a message is displayed to 
- * 				the user.
+ * Function: read_heredoc_body(int fd, char *delimiter, bool stripTabs, bool isInteractive)
+ * Description: Takes in the memfd for a here-document (-1 to discard it), its
+ * 				delimiter, whether to remove leading tabs and whether a person
+ * 				is using the shell. Reads lines up to the delimiter line into
+ * 				fd, prompting with "> " at the terminal. Returns false if the
+ * 				body could not be stored.
 ********************************************************************************/
-void check_for_background_complete(DynArr *cpids)
+bool read_heredoc_body(int fd, char *delimiter, bool stripTabs, bool isInteractive)
 {
-	int size = sizeDynArr(cpids); // Max times to run loop
-	int count = 0; // To track number of times loop has run
-	int i = 0; // To track index of cpids array
+	char *line = NULL;
+	size_t bufferSize = 0;
+	ssize_t len;
+	bool ok = (fd != -1);
 
-	// Loop while cpids is not empty and up until size
-	while (!isEmptyDynArr(cpids) && count < size)
+	while ((len = read_input_line(isInteractive, isInteractive ? "> " : NULL,
+		&line, &bufferSize)) != -1)
 	{
-		// Check if each process has completed
-		int childExitMethod = -5;
-		int result;
-		result = waitpid(getDynArr(cpids, i), &childExitMethod, WNOHANG);
-		
-		// If it has completed
-		if (result > 0)
+		char *text = line;
+		while (stripTabs && *text == '\t')
 		{
-			// Remove it from cpids
-			removeAtDynArr(cpids, i);
-			i--; // To offset losing an item
+			text++;
+			len--;
+		}
 
-			// Print either exit status or termination signal
-			printf("background pid %d is done: ", result);
-			if (WIFEXITED(childExitMethod) != 0)
-				printf("exit value %d\n", WEXITSTATUS(childExitMethod));
-			else if (WIFSIGNALED(childExitMethod) != 0)
-				printf("terminated by signal %d\n", WTERMSIG(childExitMethod));
-			fflush(stdout);
+		// The delimiter line ends the body
+		size_t textLen = (len > 0 && text[len-1] == '\n') ? len - 1 : len;
+		if (textLen == strlen(delimiter) && strncmp(text, delimiter, textLen) == 0)
+		{
+			free(line);
+			return ok;
+		}
+
+		if (ok && !heredoc_write(fd, text, len))
+		{
+			out_printf("cannot write here-document: %s\n", strerror(errno));
+			ok = false;
 		}
-		count++;
-		i++;
 	}
+
+	clearerr(stdin);
+	out_printf("warning: here-document delimited by end-of-file (wanted `%s')\n", delimiter);
+	free(line);
+	return ok;
 }
 
 
 /*******************************************************************************
- * Function: check_for_background_command(char *arguments[], int *numArgs)
- * Description: Takes in an array of strings that represent the user entered
- * 				args and a pointer to the number of args in the array. It looks
- * 				up the last position of the array and compartes it to "&" to 
- * 				check if this command is meant to be a background command. Will
- * 				NULL out the & and return true if found, otherwise returns false.
+ * Function: check_for_redirect(char *arguments[], int* numArgs, bool isBackground)
+ * Description: Takes in an array of arguments from the user and a Boolean to 
+ * 				represent whether or not this is for a background process. It
+ * 				searches the args to determine is a redirection is commanded and
+ * 				sets up the redirction to the designated files if it is. If no
+ * 				redirection is implicated for a background process, then it sets
+ * 				up redirection to dev/null.
 ********************************************************************************/
-bool check_for_background_command(char *arguments[], int *numArgs)
+void check_for_redirect(char *arguments[], int *numArgs, bool isBackground)
 {
-	// Look at last arg in list to see if it is &
-	if (strcmp(arguments[(*numArgs)-1], "&") == 0)
+	int sourceFile, targetFile;
+	if (!open_redirects(arguments, numArgs, &sourceFile, &targetFile, false))
 	{
-		// Free the memory for &
-		free(arguments[(*numArgs)-1]);
-		arguments[(*numArgs)-1] = NULL;
-		(*numArgs)--; // Update numArgs
+		out_flush();
+		exit(1);
+	}
 
-		return true;
+	// Use dev/null for background, opening it if the shell could not
+	if (sourceFile == -1 && isBackground)
+		sourceFile = DEV_NULL_FDS[0];
+	if (sourceFile == -1 && isBackground)
+		sourceFile = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	if (targetFile == -1 && isBackground)
+		targetFile = DEV_NULL_FDS[1];
+	if (targetFile == -1 && isBackground)
+		targetFile = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+	// Redirect input to given file
+	if (sourceFile != -1 && dup2(sourceFile, 0) == -1)
+	{
+		out_printf("error in dup2() redirect for input\n");
+		out_flush();
+		exit(2);
+	}
+
+	// Redirect output to given file
+	if (targetFile != -1 && dup2(targetFile, 1) == -1)
+	{
+		out_printf("error in dup2() redirect for output\n");
+		out_flush();
+		exit(2);
 	}
-	// Not background command
-	return false;
 }
 
 
 /*******************************************************************************
- * Function: expand_variables(char *lookIn, char *lookFor)
- * Source: stackoverflow.com/questions/32413667
- * Description: Takes in a string to look in and a string to look for. Uses 
- * 				strstr to look for occurances of the lookFor sting inside of the
- * 				lookIn string. If found, the loofFor portion is removed and 
- * 				replaces by the PID of the process.
+ * Function: is_copy_command(char *arguments[], int numArgs, struct JobOptions *options)
+ * Description: Takes in the user entered args, the number of args and the
+ * 				job's options. Returns true if the command is a cat or cp the
+ * 				shell can do itself: no options, not in the background, no
+ * 				prefixes or assignments that need a child process, and for cp
+ * 				a target without a trailing /. Anything else runs the real
+ * 				command.
 ********************************************************************************/
-void expand_variable(char *lookIn, char *lookFor)
-{	
-	// Get PID and convert to string
-	int pid = getpid();
-	char strPID[8];
-	snprintf(strPID, sizeof(strPID), "%d", pid);
-		
-	char buffer[2100] = { 0 }; // For piecing string back together
-	char *tmpLookIn = lookIn; // For traversing lookIn string
+bool is_copy_command(char *arguments[], int numArgs, struct JobOptions *options)
+{
+	bool isCat = strcmp(arguments[0], "cat") == 0;
+	bool isCp = strcmp(arguments[0], "cp") == 0;
+	if (!isCat && !isCp)
+		return false;
 
-	// Keep going until all lookFors are converted
-	while((tmpLookIn = strstr(tmpLookIn, lookFor))) // Will be NULL if no matches
+	// Needs a child for the deadline, placement, limits or environment
+	if (options->timeoutMs > 0 || options->placement.hasCpus ||
+		options->placement.hasNice || options->placement.batch ||
+		options->limits.enabled || options->assignments.size > 0)
+		return false;
+
+	for (int i = 1; i < numArgs; i++)
 	{
-		// Copy up until found lookin
-		strncpy(buffer, lookIn, tmpLookIn-lookIn);
-		buffer[tmpLookIn-lookIn] = '\0';
-		
-		// Add on the PID
-		strcat(buffer, strPID);
+		if ((arguments[i][0] == '-' && arguments[i][1] != '\0') ||
+			strcmp(arguments[i], "&") == 0)
+			return false;
 
-		// Add on the rest of string, after lookFor
-		strcat(buffer, tmpLookIn+strlen(lookFor));	
-		
-		// Copy re-built string into lookIn
-		strcpy(lookIn, buffer);
-		
-		tmpLookIn++;
+		// cp only takes two paths
+		if (isCp && (strcmp(arguments[i], "<") == 0 || strcmp(arguments[i], ">") == 0))
+			return false;
 	}
+
+	// A cp target ending in / must already be a directory, which cp reports
+	if (isCp && numArgs == 3 && arguments[2][strlen(arguments[2]) - 1] == '/')
+		return false;
+	return isCat || numArgs == 3;
 }
 
 
 /*******************************************************************************
- * Function: find_symbol(char *arguments[], char *symbol)
- * Description: Takes in an array of strings and a string to search for. Loops
- * 				throught the array and if the symbol is found, its position in
- * 				the array is returned. Other wise -10 is returned.
+ * Function: catch_copy_SIGINT(int signo)
+ * Description: Signal handler for CTRL-C while the shell is copying. Sets
+ * 				COPY_INTERRUPTED so the copy stops between chunks.
 ********************************************************************************/
-int find_symbol(char *arguments[], char *symbol)
+void catch_copy_SIGINT(int signo)
 {
-	int position = -10;
-	int i = 0;
-	while (arguments[i] != NULL) // Arguments last position is NULL
-	{
-		// Found the symbol in args, so return the position it is at
-		if (strcmp(arguments[i], symbol) == 0)
-		{
-			position = i;
-			break;
-		}
-		i++;
-	}
-	return position;
+	COPY_INTERRUPTED = 1;
 }
 
 
 /*******************************************************************************
- * Function: check_for_redirect(char *arguments[], int* numArgs, bool isBackground)
- * Description: Takes in an array of arguments from the user and a Boolean to 
- * 				represent whether or not this is for a background process. It
- * 				searches the args to determine is a redirection is commanded and
- * 				sets up the redirction to the designated files if it is. If no
- * 				redirection is implicated for a background process, then it sets
- * 				up redirection to dev/null.
+ * Function: my_copy(char *arguments[], int *numArgs, int stdinFd)
+ * Description: Takes in the args of a cat or cp command accepted by
+ * 				is_copy_command(), a pointer to the number of args and a
+ * 				here-document to use as stdin (-1 for none). Runs it in the
+ * 				shell with CTRL-C able to stop it like a foreground command.
+ * 				Returns the exit value, or the negated signal number if it was
+ * 				interrupted.
 ********************************************************************************/
-void check_for_redirect(char *arguments[], int *numArgs, bool isBackground)
+int my_copy(char *arguments[], int *numArgs, int stdinFd)
 {
-	int pos1 = find_symbol(arguments, "<");	// STDIN
-	int pos2 = find_symbol(arguments, ">"); // STDOUT
+	int inFd, outFd;
+	if (!open_redirects(arguments, numArgs, &inFd, &outFd, true))
+		return 1;
 
-	// Found redirection for stdin or background
-	if (pos1 >= 0 || isBackground)
+	// A here-document replaces any other stdin
+	if (stdinFd != -1)
 	{
-		int sourceFile;
+		if (inFd != -1)
+			ioring_close(inFd);
+		inFd = fcntl(stdinFd, F_DUPFD_CLOEXEC, 0);
+	}
 
-		// Open file for input with next arg
-		if (pos1 >= 0)
-			sourceFile = open(arguments[pos1+1], O_RDONLY);
-		// Open dev/null for background
-		else
-			sourceFile = open("/dev/null", O_RDONLY);
-		
-		if (sourceFile == -1)
-		{
-			printf("cannont open %s for input\n", arguments[pos1+1]);
-			fflush(stdout);
-			exit(1);
-		}
-		
-		// Close on exec
-		fcntl(sourceFile, F_SETFD, FD_CLOEXEC);
-		
-		// Redirect input to given file
-		int inResult = dup2(sourceFile, 0);
-		if (inResult == -1)
-		{
-			printf("error in dup2() redirect for input\n");
-			fflush(stdout);
-			exit(2);
-		}
+	// Anything queued must come out before the copied data
+	out_flush();
 
-		// NULL out pos so arguments will end with a NULL for exec()
-		if (pos1 >= 0)
-		{	
-			free(arguments[pos1]);
-			arguments[pos1] = NULL;
-			(*numArgs)--;
+	struct sigaction copyAction = {0}, oldAction;
+	copyAction.sa_handler = catch_copy_SIGINT;
+	sigfillset(&copyAction.sa_mask);
+	COPY_INTERRUPTED = 0;
+	sigaction(SIGINT, &copyAction, &oldAction);
 
-			free(arguments[pos1+1]);
-			arguments[pos1+1] = NULL;
-			(*numArgs)--;
-		}
-	}
+	// A reader that has gone shows up as EPIPE instead of killing the shell
+	struct sigaction ignoreAction = {0}, oldPipeAction;
+	ignoreAction.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &ignoreAction, &oldPipeAction);
 
-	// Found redirection for stdout or background
-	if (pos2 >= 0 || isBackground)
-	{
-		int targetFile;
+	int result;
+	if (strcmp(arguments[0], "cat") == 0)
+		result = my_cat(arguments, inFd != -1 ? inFd : STDIN_FILENO,
+			outFd != -1 ? outFd : STDOUT_FILENO, &COPY_INTERRUPTED);
+	else
+		result = my_cp(arguments[1], arguments[2], &COPY_INTERRUPTED);
 
-		// Open file for output with next arg
-		if (pos2 >= 0)
-			 targetFile = open(arguments[pos2+1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
-		// Open dev/null for background
-		else
-			targetFile = open("/dev/null", O_WRONLY);
+	sigaction(SIGPIPE, &oldPipeAction, NULL);
+	sigaction(SIGINT, &oldAction, NULL);
+	ioring_close(inFd);
+	ioring_close(outFd);
+	ioring_flush();
 
-		if (targetFile == -1)
-		{
-			printf("cannot open %s for output\n", arguments[pos2+1]);
-			fflush(stdout);
-			exit(1);
-		}
+	if (COPY_INTERRUPTED)
+		return -SIGINT;
+	return result;
+}
 
-		// Close on exec
-		fcntl(targetFile, F_SETFD, FD_CLOEXEC);
 
-		// Redirect output to given file
-		int outResult = dup2(targetFile, 1);
-		if (outResult == -1)
+/*******************************************************************************
+ * Function: my_cat(char *arguments[], int inFd, int outFd, volatile sig_atomic_t *stop)
+ * Description: Takes in the cat command's args, with redirection removed, and
+ * 				the descriptors to use for stdin and stdout. Copies each named
+ * 				file to outFd in order, or inFd if none are named ("-" also
+ * 				means inFd), stopping if outFd's reader goes away. Returns 1
+ * 				if any file could not be copied, otherwise 0.
+********************************************************************************/
+int my_cat(char *arguments[], int inFd, int outFd, volatile sig_atomic_t *stop)
+{
+	int result = 0;
+	bool broken = false; // outFd's reader has gone
+	char *stdinOnly[2] = {"-", NULL};
+	char **names = (arguments[1] != NULL) ? arguments + 1 : stdinOnly;
+
+	// Open the files a batch at a time, so the I/O engine opens them together
+	int count = 0;
+	for (int first = 0; names[first] != NULL && !*stop && !broken; first += count)
+	{
+		struct IoringOpen files[IORING_BATCH_MAX];
+		for (count = 0; count < IORING_BATCH_MAX && names[first+count] != NULL; count++)
 		{
-			printf("error in dup2() redirect for output\n");
-			fflush(stdout);
-			exit(2);
+			char *name = names[first+count];
+			files[count].path = (strcmp(name, "-") != 0) ? name : NULL;
+			files[count].flags = O_RDONLY | O_CLOEXEC;
+			files[count].mode = 0;
 		}
+		ioring_open(files, count, false);
 
-		// NULL out pos	
-		if (pos2 >= 0)
+		for (int i = 0; i < count; i++)
 		{
-			free(arguments[pos2]);
-			arguments[pos2] = NULL;
-			(*numArgs)--;
-
-			free(arguments[pos2+1]);
-			arguments[pos2+1] = NULL;
-			(*numArgs)--;
+			int fd = (files[i].path != NULL) ? files[i].fd : inFd;
+			if (*stop || broken)
+			{
+				// Interrupted; the rest of the batch is only closed
+			}
+			else if (fd == -1)
+			{
+				out_printf("cat: %s: %s\n", names[first+i], strerror(files[i].error));
+				result = 1;
+			}
+			else if (copy_fd(fd, outFd, stop) == -1 && errno != EINTR)
+			{
+				broken = errno == EPIPE;
+				out_printf("cat: %s: %s\n", names[first+i], strerror(errno));
+				result = 1;
+			}
+			if (fd != inFd)
+				ioring_close(fd);
 		}
 	}
+
+	out_flush();
+	return result;
+}
+
+
+/*******************************************************************************
+ * Function: my_cp(char *source, char *target, volatile sig_atomic_t *stop)
+ * Description: Takes in the source file and the target file or directory.
+ * 				Copies source to target, or into target if it is a directory,
+ * 				giving a new file the source's permissions. Returns 1 after
+ * 				displaying a message on failure, otherwise 0.
+********************************************************************************/
+int my_cp(char *source, char *target, volatile sig_atomic_t *stop)
+{
+	char path[4096];
+	struct stat sourceStat, targetStat;
+
+	int sourceFd = open(source, O_RDONLY | O_CLOEXEC);
+	if (sourceFd == -1 || fstat(sourceFd, &sourceStat) == -1)
+	{
+		out_printf("cp: cannot stat '%s': %s\n", source, strerror(errno));
+		out_flush();
+		if (sourceFd != -1)
+			close(sourceFd);
+		return 1;
+	}
+	if (S_ISDIR(sourceStat.st_mode))
+	{
+		out_printf("cp: -r not specified; omitting directory '%s'\n", source);
+		out_flush();
+		close(sourceFd);
+		return 1;
+	}
+
+	// Copy into a directory under the source's name
+	if (stat(target, &targetStat) == 0 && S_ISDIR(targetStat.st_mode))
+	{
+		char *base = strrchr(source, '/');
+		snprintf(path, sizeof(path), "%s/%s", target, base != NULL ? base + 1 : source);
+		target = path;
+	}
+
+	if (stat(target, &targetStat) == 0 && targetStat.st_dev == sourceStat.st_dev &&
+		targetStat.st_ino == sourceStat.st_ino)
+	{
+		out_printf("cp: '%s' and '%s' are the same file\n", source, target);
+		out_flush();
+		close(sourceFd);
+		return 1;
+	}
+
+	int targetFd = open(target, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		sourceStat.st_mode & 0777);
+	if (targetFd == -1)
+	{
+		out_printf("cp: cannot create regular file '%s': %s\n", target, strerror(errno));
+		out_flush();
+		close(sourceFd);
+		return 1;
+	}
+
+	int result = 0;
+	if (copy_fd(sourceFd, targetFd, stop) == -1 && errno != EINTR)
+	{
+		out_printf("cp: error copying '%s' to '%s': %s\n", source, target, strerror(errno));
+		out_flush();
+		result = 1;
+	}
+	close(sourceFd);
+	close(targetFd);
+	return result;
 }
 
 
 /*******************************************************************************
- * Function: execute(char *arguments[], int *numArgs, bool isBackground)
- * Description: Takes in an array of user entered arguments and a Boolean that is
- * 				a flag for background processes. Passes the args to set up any
- * 				redirection and calls execvp() to execute the desired process.
+ * Function: execute(char *arguments[], int *numArgs, bool isBackground, struct JobOptions *options)
+ * Description: Takes in an array of user entered arguments, a Boolean that is
+ * 				a flag for background processes and the job's options. Passes
+ * 				the args to set up any redirection and execs the desired process
+ * 				with the shell's environment plus the command's assignments,
+ * 				using the path from the PATH trie when it has been built and
+ * 				execvp() otherwise. The batch command is run in place of exec.
 ********************************************************************************/
-void execute(char *arguments[], int *numArgs, bool isBackground)
+void execute(char *arguments[], int *numArgs, bool isBackground, struct JobOptions *options)
 {
+	extern char **environ;
 	check_for_redirect(arguments, numArgs, isBackground);
 
-	// Create the new process
+	// A here-document or coprocess pipe replaces any other stdin
+	if (options->stdinFd != -1 && dup2(options->stdinFd, 0) == -1)
+	{
+		out_printf("error in dup2() redirect for input\n");
+		out_flush();
+		exit(2);
+	}
+
+	// A fan-out, coprocess or memo pipe replaces any other stdout
+	if (options->stdoutFd != -1 && dup2(options->stdoutFd, 1) == -1)
+	{
+		out_printf("error in dup2() redirect for output\n");
+		out_flush();
+		exit(2);
+	}
+	if (options->stderrFd != -1 && dup2(options->stderrFd, 2) == -1)
+	{
+		out_printf("error in dup2() redirect for errors\n");
+		out_flush();
+		exit(2);
+	}
+
+	// The command's own assignments only go into this child's environment
+	char **envp = env_block();
+	bool ownPath = false;
+	if (options->assignments.size > 0)
+	{
+		envp = env_overlay(options->assignments.items, options->assignments.size);
+		for (int i = 0; i < options->assignments.size; i++)
+			ownPath = ownPath || strncmp(options->assignments.items[i], "PATH=", 5) == 0;
+	}
+	environ = envp; // So execvp() searches the PATH the command will see
+
+	// batch runs here in the child and supervises its own invocations
+	if (strcmp(arguments[0], "batch") == 0)
+	{
+		int status = batch_run(arguments, !ownPath);
+		out_flush();
+		exit(status);
+	}
+
+	// Exec straight from the PATH trie if it knows the command
+	const char *path = ownPath ? NULL : path_trie_lookup(arguments[0]);
+	if (path != NULL)
+		execve(path, arguments, envp);
+
+	// Create the new process (not in the trie, or the trie was stale)
 	if (execvp(arguments[0], arguments) < 0)
 	{
-		printf("%s: command not found\n", arguments[0]);
-		fflush(stdout);
+		out_printf("%s: command not found\n", arguments[0]);
+		out_flush();
 		exit(1);
 	}
 }
@@ -555,21 +1862,24 @@ void check_exit_status(struct Status *lastStatus, int childExitMethod)
  * 				or the last terminating signal number. The exit status being set
  * 				to -100 indicates that the last process was terminated, otherwise
  * 				the last process was exited. The corresponding message will be
- * 				displayed to the user.
+ * 				displayed to the user, prefixed with "timed out" if the process
+ * 				was signaled by its deadline.
 ********************************************************************************/
 void my_status(struct Status lastStatus)
 {
+	// The last process was stopped by its deadline
+	if (lastStatus.timedOut)
+		out_printf("timed out, ");
+
 	// The last process exited
 	if (lastStatus.exitStatus != -100)
 	{
-		printf("exit value %d\n", lastStatus.exitStatus);
-		fflush(stdout);
+		out_printf("exit value %d\n", lastStatus.exitStatus);
 	}
 	// The last process was terminated
 	else
 	{
-		printf("terminated by signal %d\n", lastStatus.termStatus);
-		fflush(stdout);
+		out_printf("terminated by signal %d\n", lastStatus.termStatus);
 	}
 }
 
@@ -585,8 +1895,9 @@ void my_cd(char *path)
 	// No path specified, so move to home directory
 	if (path == NULL)
 	{
-		char *home = getenv("HOME");
-		chdir(home);
+		const char *home = env_get("HOME");
+		if (home != NULL)
+			chdir(home);
 	}
 	// Move to specified path
 	else
@@ -597,35 +1908,187 @@ void my_cd(char *path)
 
 
 /*******************************************************************************
- * Function: my_exit(DynArr *cpids)
- * Description: Takes in an array of child pids. Loops through the pids to send
- * 				SIGTERM signal to each one before exiting the program.
+ * Function: my_history(char *count)
+ * Description: Takes in an optional string for the number of entries to show.
+ * 				Prints the last count history entries (all of them if count is
+ * 				not specified), numbered from 1 like bash does.
+********************************************************************************/
+void my_history(char *count)
+{
+	int size = history_size();
+	int first = 0;
+
+	// Only show the newest entries if a count was given
+	if (count != NULL && atoi(count) > 0 && atoi(count) < size)
+		first = size - atoi(count);
+
+	char entry[MAX_INPUT+1];
+	for (int i = first; i < size; i++)
+	{
+		history_entry(i, entry, sizeof(entry));
+		out_printf("%5d  %s\n", i+1, entry);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: start_history(bool isInteractive)
+ * Description: Takes in a Boolean for whether a person is using the shell.
+ * 				Opens the history log named by SMALLSH_HISTORY, or for an
+ * 				interactive shell ~/.smallsh_history. Scripts get no history
+ * 				unless SMALLSH_HISTORY is set.
+********************************************************************************/
+void start_history(bool isInteractive)
+{
+	char path[4096];
+	const char *histFile = env_get("SMALLSH_HISTORY");
+	const char *home = env_get("HOME");
+
+	if (histFile != NULL && histFile[0] != '\0')
+		snprintf(path, sizeof(path), "%s", histFile);
+	else if (isInteractive && home != NULL)
+		snprintf(path, sizeof(path), "%s/%s", home, HISTORY_FILE);
+	else
+		return;
+
+	if (!history_init(path))
+	{
+		out_printf("cannot open history file %s\n", path);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: expand_history(char **line, size_t *bufferSize)
+ * Description: Takes in the user entered line and the size of its buffer. If
+ * 				the line is a !prefix recall, it is replaced with the newest
+ * 				history entry starting with prefix and echoed back to the user.
+ * 				Returns false if no entry matches, otherwise true.
+********************************************************************************/
+bool expand_history(char **line, size_t *bufferSize)
+{
+	if ((*line)[0] != '!' || !history_enabled())
+		return true;
+
+	// Prefix runs from after the ! up to the newline
+	char prefix[MAX_INPUT+1];
+	snprintf(prefix, sizeof(prefix), "%s", *line + 1);
+	prefix[strcspn(prefix, "\n")] = '\0';
+
+	int id = history_find_prefix(prefix);
+	if (id == -1)
+	{
+		out_printf("!%s: event not found\n", prefix);
+		return false;
+	}
+
+	// Make room for the entry plus newline and null terminator
+	if (*bufferSize < MAX_INPUT + 2)
+	{
+		*bufferSize = MAX_INPUT + 2;
+		*line = realloc(*line, *bufferSize);
+	}
+	int len = history_entry(id, *line, MAX_INPUT + 1);
+	strcpy(*line + len, "\n");
+
+	out_printf("%s", *line);
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: my_export(char *arguments[])
+ * Description: Takes in the export command's args. Each NAME=value sets a
+ * 				variable in the environment passed to later commands; a plain
+ * 				NAME is accepted since every variable is exported. With no
+ * 				names all variables are displayed.
+********************************************************************************/
+void my_export(char *arguments[])
+{
+	if (arguments[1] == NULL)
+	{
+		char **envp = env_block();
+		for (int i = 0; envp[i] != NULL; i++)
+			out_printf("export %s\n", envp[i]);
+		return;
+	}
+
+	for (int i = 1; arguments[i] != NULL; i++)
+	{
+		if (!env_valid_name(arguments[i]))
+			out_printf("export: %s: not a valid identifier\n", arguments[i]);
+		else if (strchr(arguments[i], '=') != NULL)
+			env_put(arguments[i]);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: my_unset(char *arguments[])
+ * Description: Takes in the unset command's args and removes each named
+ * 				variable from the environment passed to later commands.
+********************************************************************************/
+void my_unset(char *arguments[])
+{
+	for (int i = 1; arguments[i] != NULL; i++)
+	{
+		if (!env_valid_name(arguments[i]) || strchr(arguments[i], '=') != NULL)
+			out_printf("unset: %s: not a valid identifier\n", arguments[i]);
+		else
+			env_unset(arguments[i]);
+	}
+}
+
+
+/*******************************************************************************
+ * Function: my_exit(PidVec *cpids)
+ * Description: Takes in an array of child pids. Sends SIGTERM to each job's
+ * 				process group and gives them until SMALLSH_EXIT_TIMEOUT
+ * 				milliseconds (2000 by default) to exit, then sends SIGKILL to
+ * 				any still running. All jobs are reaped and a summary is
+ * 				displayed before exiting the program.
 ********************************************************************************/
-void my_exit(DynArr *cpids)
+void my_exit(PidVec *cpids)
 {
-	// Loop through child pids to kill all child process
-	int size = sizeDynArr(cpids);
+	// Deadline can be configured through the environment
+	long deadlineMs = EXIT_TIMEOUT_MS;
+	const char *timeout = env_get("SMALLSH_EXIT_TIMEOUT");
+	if (timeout != NULL && atol(timeout) >= 0 && timeout[0] != '\0')
+		deadlineMs = atol(timeout);
 
-	for(int i = 0; i < size; i++)
+	// Coprocesses that stop at end of file can finish on their own
+	coproc_close_all();
+
+	struct ShutdownReport report;
+	shutdown_jobs(cpids, deadlineMs, &report);
+	cgroup_close_all();
+	jobstate_close();
+
+	if (report.jobs > 0)
 	{
-		kill(getDynArr(cpids, i), SIGKILL);
+		out_printf("shutdown: %d background jobs, %d exited, %d killed", report.jobs,
+			report.exited, report.killed);
+		if (report.lost > 0)
+			out_printf(", %d not reaped", report.lost);
+		out_printf(" (%ld ms)\n", report.elapsedMs);
 	}
+	out_flush();
 	
 	exit(0);
 }
 
 
 /*******************************************************************************
- * Function: execute_built_in(char *arguemtns[], DynArr *cpids)
+ * Function: execute_built_in(char *arguemtns[], PidVec *cpids)
  * Description: Takes in an array of user inputted arguments in which the first 
  * 				argument is a built in command, an array of child pids, and an
  *				int that represents the either the exit status or terminating
  *				signal number of the last ran foreground process.
  * 				Uses the first argument from the user to determine which built
  * 				in command to run. 
- * Currently supports EXIT, CD, and STATUS
+ * Currently supports EXIT, CD, STATUS, HISTORY, EXPORT, UNSET, and WATCH
 ********************************************************************************/
-void execute_built_in(char *arguments[], DynArr *cpids, struct Status lastStatus)
+void execute_built_in(char *arguments[], PidVec *cpids, struct Status lastStatus)
 {
 	// EXIT
 	if(strcmp(arguments[0], "exit") == 0)
@@ -638,6 +2101,33 @@ void execute_built_in(char *arguments[], DynArr *cpids, struct Status lastStatus
 	// STATUS
 	else if(strcmp(arguments[0], "status") == 0)
 		my_status(lastStatus);
+
+	// HISTORY
+	else if(strcmp(arguments[0], "history") == 0)
+		my_history(arguments[1]);
+
+	// EXPORT
+	else if(strcmp(arguments[0], "export") == 0)
+		my_export(arguments);
+
+	// UNSET
+	else if(strcmp(arguments[0], "unset") == 0)
+		my_unset(arguments);
+
+	// WATCH
+	else if(strcmp(arguments[0], "watch") == 0)
+		watch_run(arguments, spawn_watched);
+
+	// COPROC - tracked with the background jobs
+	else if(strcmp(arguments[0], "coproc") == 0)
+	{
+		pid_t spawnPid = coproc_start(arguments, spawn_coproc);
+		if (spawnPid > 0)
+		{
+			pid_vec_push(cpids, spawnPid);
+			out_printf("background pid is %d\n", spawnPid);
+		}
+	}
 }
 
 
@@ -674,15 +2164,16 @@ void free_args_memory(char *arguments[], int numArgs)
 
 
 /*******************************************************************************
- * Function: parse_args_to_arr(char *line, char *arguments[], int *numArgs)
- * Description: Takes in the user entered string of arguments, an empty array of
- * 				pointers to chars, and a pointer to the number of elements in the
- * 				array.
+ * Function: parse_args_to_arr(char *line, ArgVec *args)
+ * Description: Takes in the user entered string of arguments and an
+ * 				uninitialized vector for them.
  * 				Uses strtok() to parse the string by spaces, then copies each
- * 				string into the arguments array.
+ * 				string into the vector, which stays NULL terminated.
 ********************************************************************************/
- void parse_args_to_arr(char *line, char *arguments[], int *numArgs)
+ void parse_args_to_arr(char *line, ArgVec *args)
  {
+	arg_vec_init(args);
+
 	// Remove trailing new line from getline and add null terminator
 	line[strcspn(line, "\n")] = '\0';
 
@@ -691,16 +2182,17 @@ void free_args_memory(char *arguments[], int numArgs)
 	while (token != NULL) // Keep parsing until there are no strings left
 	{
 		// Allocate memory and copy into args array
-		arguments[*numArgs] = malloc((strlen(token)+1) * sizeof(char));
-		strcpy(arguments[*numArgs], token);
-		(*numArgs)++;
+		char *arg = malloc((strlen(token)+1) * sizeof(char));
+		strcpy(arg, token);
+		arg_vec_push(args, arg);
 
 		// Get next string
 		token = strtok(NULL, " ");
 	}
 
-	// Set last spot in array to NULL
-	arguments[*numArgs] = NULL;
+	// Set last spot in array to NULL, past the end of the vector
+	arg_vec_push(args, NULL);
+	args->size--;
  }
 
 
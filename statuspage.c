@@ -0,0 +1,212 @@
+/*******************************************************************************
+ * File: statuspage.c
+ * Description: Implements the live job status page described in
+ * 				statuspage.h. Every change is made between begin_update() and
+ * 				end_update(), which move the sequence lock, so a monitor
+ * 				reading the mapping never sees a half-written table. Does
+ * 				nothing unless SMALLSH_STATUS_PAGE is set.
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include "output.h"
+#include "envstore.h"
+#include "statuspage.h"
+
+// Globals
+static struct StatusPage *PAGE = NULL;
+static char *PAGE_PATH = NULL;
+static pid_t PAGE_OWNER = 0; // Only the shell itself removes the file
+
+
+/*******************************************************************************
+ * Function: now_ns()
+ * Description: Returns the wall clock time in nanoseconds.
+*******************************************************************************/
+static int64_t now_ns(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/*******************************************************************************
+ * Function: begin_update()
+ * Description: Makes the sequence odd so readers retry, and keeps the writes
+ * 				that follow from being seen before it.
+*******************************************************************************/
+static void begin_update(void)
+{
+	__atomic_store_n(&PAGE->sequence, PAGE->sequence + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+
+/*******************************************************************************
+ * Function: end_update()
+ * Description: Stamps the page and makes the sequence even again, publishing
+ * 				the writes made since begin_update().
+*******************************************************************************/
+static void end_update(void)
+{
+	PAGE->updatedNs = now_ns();
+	__atomic_store_n(&PAGE->sequence, PAGE->sequence + 1, __ATOMIC_RELEASE);
+}
+
+
+/*******************************************************************************
+ * Function: status_page_close()
+ * Description: Unmaps the page and removes the file. Registered with atexit()
+ * 				and skipped in forked children so only the shell removes it.
+*******************************************************************************/
+static void status_page_close(void)
+{
+	if (PAGE == NULL || getpid() != PAGE_OWNER)
+		return;
+
+	munmap(PAGE, sizeof(struct StatusPage));
+	unlink(PAGE_PATH);
+	PAGE = NULL;
+}
+
+
+/*******************************************************************************
+ * Function: status_page_open()
+ * Description: Creates the status page if SMALLSH_STATUS_PAGE is set. A page
+ * 				that cannot be created is reported once and then skipped.
+*******************************************************************************/
+void status_page_open(void)
+{
+	const char *setting = env_get("SMALLSH_STATUS_PAGE");
+	if (setting == NULL || setting[0] == '\0')
+		return;
+
+	char path[4096];
+	if (strcmp(setting, "1") == 0)
+		snprintf(path, sizeof(path), "/dev/shm/smallsh.%d", getpid());
+	else
+		snprintf(path, sizeof(path), "%s", setting);
+
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd == -1 || ftruncate(fd, sizeof(struct StatusPage)) == -1)
+	{
+		out_printf("cannot create status page %s\n", path);
+		if (fd != -1)
+			close(fd);
+		return;
+	}
+
+	void *map = mmap(NULL, sizeof(struct StatusPage), PROT_READ | PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+	{
+		out_printf("cannot create status page %s\n", path);
+		unlink(path);
+		return;
+	}
+
+	// The file starts out zeroed, so the sequence is already even
+	PAGE = map;
+	PAGE_PATH = strdup(path);
+	PAGE_OWNER = getpid();
+	atexit(status_page_close);
+
+	begin_update();
+	PAGE->magic = STATUS_MAGIC;
+	PAGE->version = STATUS_VERSION;
+	PAGE->size = sizeof(struct StatusPage);
+	PAGE->shellPid = getpid();
+	PAGE->lastExitStatus = 0;
+	PAGE->lastTermSignal = -100;
+	end_update();
+}
+
+
+/*******************************************************************************
+ * Function: status_page_add(pid_t pid, char *arguments[], bool isBackground)
+ * Description: Lists a job that was just started, with its args joined by
+ * 				spaces as the command.
+*******************************************************************************/
+void status_page_add(pid_t pid, char *arguments[], bool isBackground)
+{
+	if (PAGE == NULL)
+		return;
+
+	struct StatusJob *job = NULL;
+	for (int i = 0; i < STATUS_MAX_JOBS && job == NULL; i++)
+	{
+		if (PAGE->jobs[i].pid == 0)
+			job = &PAGE->jobs[i];
+	}
+
+	begin_update();
+	if (job == NULL)
+	{
+		PAGE->dropped++;
+	}
+	else
+	{
+		job->pid = pid;
+		job->state = isBackground ? STATUS_BACKGROUND : STATUS_FOREGROUND;
+		job->startNs = now_ns();
+
+		size_t used = 0;
+		job->command[0] = '\0';
+		for (int i = 0; arguments[i] != NULL && used < STATUS_COMMAND_LEN - 1; i++)
+		{
+			used += snprintf(job->command + used, STATUS_COMMAND_LEN - used, "%s%s",
+				(i > 0) ? " " : "", arguments[i]);
+		}
+		PAGE->numJobs++;
+	}
+	end_update();
+}
+
+
+/*******************************************************************************
+ * Function: status_page_remove(pid_t pid)
+ * Description: Removes a job that has been reaped.
+*******************************************************************************/
+void status_page_remove(pid_t pid)
+{
+	if (PAGE == NULL)
+		return;
+
+	for (int i = 0; i < STATUS_MAX_JOBS; i++)
+	{
+		if (PAGE->jobs[i].pid == pid)
+		{
+			begin_update();
+			memset(&PAGE->jobs[i], 0, sizeof(struct StatusJob));
+			PAGE->numJobs--;
+			end_update();
+			return;
+		}
+	}
+}
+
+
+/*******************************************************************************
+ * Function: status_page_last(int exitStatus, int termStatus, bool timedOut)
+ * Description: Records the status of the last foreground command.
+*******************************************************************************/
+void status_page_last(int exitStatus, int termStatus, bool timedOut)
+{
+	if (PAGE == NULL)
+		return;
+
+	begin_update();
+	PAGE->lastExitStatus = exitStatus;
+	PAGE->lastTermSignal = termStatus;
+	PAGE->lastTimedOut = timedOut;
+	end_update();
+}
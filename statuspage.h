@@ -0,0 +1,82 @@
+/*******************************************************************************
+ * File: statuspage.h
+ * Description: Live job status page. When SMALLSH_STATUS_PAGE is set the shell
+ * 				keeps a table of its running jobs in a shared file that
+ * 				monitors can mmap and read without calling into the shell.
+ * 				SMALLSH_STATUS_PAGE=1 uses /dev/shm/smallsh.<pid>; any other
+ * 				value is taken as the path. The file is removed when the shell
+ * 				exits.
+ *
+ * Format (version 1): the file is exactly one struct StatusPage in the shell's
+ * native byte order, with the fixed-size fields below. A reader must check
+ * magic, version and size before using anything else.
+ *
+ * The page is protected by a sequence lock. The shell makes sequence odd
+ * before it changes anything and even again when it is done. To take a
+ * consistent snapshot a reader:
+ * 	1. loads sequence (acquire) and starts over if it is odd
+ * 	2. copies the page
+ * 	3. issues an acquire fence and loads sequence again
+ * 	4. starts over if it changed
+ * The shell never waits for readers, so a reader should retry rather than
+ * block.
+ *
+ * jobs[] has STATUS_MAX_JOBS slots; a slot is in use if its pid is not 0 and
+ * used slots are not necessarily contiguous. numJobs counts the used slots,
+ * and dropped counts jobs that were not listed because the table was full.
+ * Times are CLOCK_REALTIME nanoseconds. Commands longer than
+ * STATUS_COMMAND_LEN - 1 bytes are truncated; command is always null
+ * terminated. lastExitStatus and lastTermSignal describe the last foreground
+ * command as the status builtin does: -100 in one of them means the other
+ * applies.
+*******************************************************************************/
+#ifndef STATUSPAGE_INCLUDED
+#define STATUSPAGE_INCLUDED 1
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Constants
+#define STATUS_MAGIC 0x53534853 // "SHSS"
+#define STATUS_VERSION 1
+#define STATUS_MAX_JOBS 64
+#define STATUS_COMMAND_LEN 128
+
+// Job states
+#define STATUS_FOREGROUND 1
+#define STATUS_BACKGROUND 2
+
+// A running job
+struct StatusJob
+{
+	int32_t pid; // 0 for an unused slot
+	uint32_t state; // STATUS_FOREGROUND or STATUS_BACKGROUND
+	int64_t startNs;
+	char command[STATUS_COMMAND_LEN];
+};
+
+// The whole file
+struct StatusPage
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size; // sizeof(struct StatusPage)
+	int32_t shellPid;
+	uint64_t sequence; // Odd while the shell is changing the page
+	int64_t updatedNs;
+	int32_t lastExitStatus;
+	int32_t lastTermSignal;
+	uint32_t lastTimedOut;
+	uint32_t numJobs;
+	uint32_t dropped;
+	uint32_t reserved;
+	struct StatusJob jobs[STATUS_MAX_JOBS];
+};
+
+void status_page_open(void);
+void status_page_add(pid_t pid, char *arguments[], bool isBackground);
+void status_page_remove(pid_t pid);
+void status_page_last(int exitStatus, int termStatus, bool timedOut);
+
+#endif
@@ -0,0 +1,408 @@
+/*******************************************************************************
+ * File: timers.c
+ * Description: Implements job deadlines. The heap is ordered by absolute
+ * 				CLOCK_MONOTONIC deadline and the timerfd is re-armed whenever
+ * 				its top changes. When the timerfd fires, every due job is sent
+ * 				its signal (to its process group if it leads one) and its pid
+ * 				is remembered as timed out until the job is reaped. A small
+ * 				hash table from pid to heap position, kept current as entries
+ * 				move, lets a deadline be cancelled in O(log n).
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include "vec.h"
+#include "timers.h"
+#include "util.h"
+
+// Constants
+#define POLL_MS 10 // Child check interval when there is no pidfd
+
+// A job's deadline
+struct Deadline
+{
+	long when; // CLOCK_MONOTONIC milliseconds
+	pid_t pid;
+	int signo;
+};
+
+// A pid's place in the heap; pid 0 marks a free slot
+struct Slot
+{
+	pid_t pid;
+	int index;
+};
+
+// Signal names accepted by parse_signal()
+static const struct { const char *name; int signo; } SIGNALS[] = {
+	{"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+	{"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"ALRM", SIGALRM}, {"TERM", SIGTERM}
+};
+
+// Globals
+static int TIMER_FD = -1;
+static struct Deadline *HEAP = NULL;
+static int HEAP_SIZE = 0;
+static int HEAP_CAP = 0;
+static struct Slot *SLOTS = NULL; // Open addressing, twice HEAP_CAP
+static int NUM_SLOTS = 0;
+static PidVec TIMED_OUT = {NULL, 0, 0}; // Pids signaled by a deadline, not yet reaped
+
+
+/*******************************************************************************
+ * Function: timer_fd()
+ * Description: Returns the timerfd, creating it on first use. It becomes
+ * 				readable when the earliest deadline is reached. Returns -1 if
+ * 				timerfds are not available.
+*******************************************************************************/
+int timer_fd(void)
+{
+	if (TIMER_FD == -1)
+		TIMER_FD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	return TIMER_FD;
+}
+
+
+/*******************************************************************************
+ * Function: arm()
+ * Description: Sets the timerfd to fire at the earliest deadline, or disarms
+ * 				it if there are none.
+*******************************************************************************/
+static void arm(void)
+{
+	struct itimerspec spec = {0};
+	if (HEAP_SIZE > 0)
+	{
+		spec.it_value.tv_sec = HEAP[0].when / 1000;
+		spec.it_value.tv_nsec = (HEAP[0].when % 1000) * 1000000L;
+		// A zero it_value would disarm the timer instead of firing it
+		if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+			spec.it_value.tv_nsec = 1;
+	}
+	timerfd_settime(timer_fd(), TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+
+/*******************************************************************************
+ * Function: slot_find(pid_t pid)
+ * Description: Returns the slot holding pid, or the free slot where it would
+ * 				go.
+*******************************************************************************/
+static struct Slot *slot_find(pid_t pid)
+{
+	unsigned mask = NUM_SLOTS - 1;
+	unsigned i = ((unsigned)pid * 2654435761u) & mask;
+	while (SLOTS[i].pid != 0 && SLOTS[i].pid != pid)
+		i = (i + 1) & mask;
+	return &SLOTS[i];
+}
+
+
+/*******************************************************************************
+ * Function: slot_remove(pid_t pid)
+ * Description: Forgets pid's heap position, moving back any later entries of
+ * 				its probe run so lookups still reach them.
+*******************************************************************************/
+static void slot_remove(pid_t pid)
+{
+	unsigned mask = NUM_SLOTS - 1;
+	struct Slot *slot = slot_find(pid);
+	if (slot->pid == 0)
+		return;
+
+	unsigned hole = slot - SLOTS;
+	for (unsigned i = (hole + 1) & mask; SLOTS[i].pid != 0; i = (i + 1) & mask)
+	{
+		// An entry may fill the hole if its home is not between the two
+		unsigned home = ((unsigned)SLOTS[i].pid * 2654435761u) & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask))
+		{
+			SLOTS[hole] = SLOTS[i];
+			hole = i;
+		}
+	}
+	SLOTS[hole].pid = 0;
+}
+
+
+/*******************************************************************************
+ * Function: place(int i, struct Deadline deadline)
+ * Description: Stores a deadline at heap position i and records where it is.
+*******************************************************************************/
+static void place(int i, struct Deadline deadline)
+{
+	HEAP[i] = deadline;
+	struct Slot *slot = slot_find(deadline.pid);
+	slot->pid = deadline.pid;
+	slot->index = i;
+}
+
+
+/*******************************************************************************
+ * Function: swap(int i, int j)
+ * Description: Swaps two heap entries.
+*******************************************************************************/
+static void swap(int i, int j)
+{
+	struct Deadline temp = HEAP[i];
+	place(i, HEAP[j]);
+	place(j, temp);
+}
+
+
+/*******************************************************************************
+ * Function: sift_up(int i) / sift_down(int i)
+ * Description: Restore the heap order after entry i moved.
+*******************************************************************************/
+static void sift_up(int i)
+{
+	while (i > 0 && HEAP[(i-1)/2].when > HEAP[i].when)
+	{
+		swap(i, (i-1)/2);
+		i = (i-1)/2;
+	}
+}
+
+static void sift_down(int i)
+{
+	while (1)
+	{
+		int smallest = i;
+		int left = 2*i + 1;
+		int right = 2*i + 2;
+		if (left < HEAP_SIZE && HEAP[left].when < HEAP[smallest].when)
+			smallest = left;
+		if (right < HEAP_SIZE && HEAP[right].when < HEAP[smallest].when)
+			smallest = right;
+		if (smallest == i)
+			return;
+		swap(i, smallest);
+		i = smallest;
+	}
+}
+
+
+/*******************************************************************************
+ * Function: remove_at(int i)
+ * Description: Removes heap entry i.
+*******************************************************************************/
+static void remove_at(int i)
+{
+	slot_remove(HEAP[i].pid);
+	HEAP_SIZE--;
+	if (i == HEAP_SIZE)
+		return;
+	place(i, HEAP[HEAP_SIZE]);
+	sift_up(i);
+	sift_down(i);
+}
+
+
+/*******************************************************************************
+ * Function: timer_add(pid_t pid, long timeoutMs, int signo)
+ * Description: Sends signo to pid once timeoutMs milliseconds have passed,
+ * 				unless the deadline is cancelled first. Replaces any deadline
+ * 				pid already had.
+*******************************************************************************/
+void timer_add(pid_t pid, long timeoutMs, int signo)
+{
+	if (timer_fd() == -1)
+		return;
+	timer_cancel(pid);
+
+	if (HEAP_SIZE == HEAP_CAP)
+	{
+		HEAP_CAP = (HEAP_CAP == 0) ? 16 : HEAP_CAP * 2;
+		HEAP = realloc(HEAP, HEAP_CAP * sizeof(struct Deadline));
+
+		// Rehash into a table kept at most half full
+		free(SLOTS);
+		NUM_SLOTS = HEAP_CAP * 2;
+		SLOTS = calloc(NUM_SLOTS, sizeof(struct Slot));
+		for (int i = 0; i < HEAP_SIZE; i++)
+			place(i, HEAP[i]);
+	}
+	struct Deadline deadline = {now_ms() + timeoutMs, pid, signo};
+	place(HEAP_SIZE, deadline);
+	HEAP_SIZE++;
+	sift_up(HEAP_SIZE - 1);
+
+	if (HEAP[0].pid == pid)
+		arm();
+}
+
+
+/*******************************************************************************
+ * Function: timer_cancel(pid_t pid)
+ * Description: Drops the deadline of pid, if it has one.
+*******************************************************************************/
+void timer_cancel(pid_t pid)
+{
+	if (HEAP_SIZE == 0)
+		return;
+	struct Slot *slot = slot_find(pid);
+	if (slot->pid == 0)
+		return;
+
+	int i = slot->index;
+	remove_at(i);
+	if (i == 0)
+		arm();
+}
+
+
+/*******************************************************************************
+ * Function: timer_expire()
+ * Description: Signals every job whose deadline has passed and re-arms the
+ * 				timerfd for the next one. Cheap to call when nothing is due.
+*******************************************************************************/
+void timer_expire(void)
+{
+	if (TIMER_FD == -1 || HEAP_SIZE == 0)
+		return;
+
+	// Clear the expiration count so the fd stops polling readable
+	unsigned long long expirations;
+	read(TIMER_FD, &expirations, sizeof(expirations));
+
+	long now = now_ms();
+	bool fired = false;
+	while (HEAP_SIZE > 0 && HEAP[0].when <= now)
+	{
+		if (killpg(HEAP[0].pid, HEAP[0].signo) == -1)
+			kill(HEAP[0].pid, HEAP[0].signo);
+
+		pid_vec_push(&TIMED_OUT, HEAP[0].pid);
+
+		remove_at(0);
+		fired = true;
+	}
+	if (fired)
+		arm();
+}
+
+
+/*******************************************************************************
+ * Function: timer_take_timeout(pid_t pid)
+ * Description: Returns true if pid was signaled because its deadline passed,
+ * 				and forgets it. Called once the job has been reaped.
+*******************************************************************************/
+bool timer_take_timeout(pid_t pid)
+{
+	for (int i = 0; i < TIMED_OUT.size; i++)
+	{
+		if (TIMED_OUT.items[i] == pid)
+		{
+			pid_vec_swap_remove(&TIMED_OUT, i);
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/*******************************************************************************
+ * Function: timer_wait_child(pid_t pid, int *childExitMethod, struct rusage *usage)
+ * Description: wait4() for a foreground child that keeps servicing deadlines,
+ * 				filling in its resource usage. With no deadlines pending it is
+ * 				a plain blocking wait4(). Otherwise it polls the child's pidfd
+ * 				and the timerfd together (or checks the child every POLL_MS if
+ * 				there is no pidfd). Returns the reaped pid, or -1 on error.
+*******************************************************************************/
+pid_t timer_wait_child(pid_t pid, int *childExitMethod, struct rusage *usage)
+{
+	pid_t result;
+	if (HEAP_SIZE == 0)
+	{
+		do
+		{
+			result = wait4(pid, childExitMethod, 0, usage);
+		} while (result == -1 && errno == EINTR);
+		return result;
+	}
+
+	int pidfd = -1;
+#ifdef SYS_pidfd_open
+	pidfd = syscall(SYS_pidfd_open, pid, 0);
+#endif
+
+	struct pollfd fds[2];
+	fds[0].fd = TIMER_FD;
+	fds[0].events = POLLIN;
+	fds[1].fd = pidfd;
+	fds[1].events = POLLIN;
+
+	while ((result = wait4(pid, childExitMethod, WNOHANG, usage)) == 0)
+	{
+		int ready = poll(fds, (pidfd != -1) ? 2 : 1, (pidfd != -1) ? -1 : POLL_MS);
+		if (ready > 0 && (fds[0].revents & POLLIN))
+			timer_expire();
+	}
+
+	if (pidfd != -1)
+		close(pidfd);
+	return result;
+}
+
+
+/*******************************************************************************
+ * Function: parse_duration(const char *text)
+ * Description: Converts a duration such as 30, 1.5s, 250ms, 2m or 1h into
+ * 				milliseconds. A bare number is seconds. Returns -1 if the text
+ * 				is not a valid duration.
+*******************************************************************************/
+long parse_duration(const char *text)
+{
+	char *end;
+	double value = strtod(text, &end);
+	if (end == text || value < 0)
+		return -1;
+
+	double scale;
+	if (*end == '\0' || strcmp(end, "s") == 0)
+		scale = 1000;
+	else if (strcmp(end, "ms") == 0)
+		scale = 1;
+	else if (strcmp(end, "m") == 0)
+		scale = 60 * 1000;
+	else if (strcmp(end, "h") == 0)
+		scale = 60 * 60 * 1000;
+	else
+		return -1;
+
+	return (long)(value * scale + 0.5);
+}
+
+
+/*******************************************************************************
+ * Function: parse_signal(const char *text)
+ * Description: Converts a signal number or name (TERM, SIGTERM, ...) into a
+ * 				signal number. Returns -1 if it is not recognized.
+*******************************************************************************/
+int parse_signal(const char *text)
+{
+	char *end;
+	long number = strtol(text, &end, 10);
+	if (end != text && *end == '\0')
+		return (number > 0 && number < NSIG) ? number : -1;
+
+	if (strncmp(text, "SIG", 3) == 0)
+		text += 3;
+	for (int i = 0; i < (int)(sizeof(SIGNALS) / sizeof(SIGNALS[0])); i++)
+	{
+		if (strcmp(text, SIGNALS[i].name) == 0)
+			return SIGNALS[i].signo;
+	}
+	return -1;
+}
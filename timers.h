@@ -0,0 +1,25 @@
+/*******************************************************************************
+ * File: timers.h
+ * Description: Job deadlines for the timeout built in and the default
+ * 				per-command deadline. All deadlines live in one min-heap backed
+ * 				by a single timerfd that is armed for the earliest of them, so
+ * 				any number of timed jobs costs nothing until one expires.
+*******************************************************************************/
+#ifndef TIMERS_INCLUDED
+#define TIMERS_INCLUDED 1
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+int timer_fd(void);
+void timer_add(pid_t pid, long timeoutMs, int signo);
+void timer_cancel(pid_t pid);
+void timer_expire(void);
+bool timer_take_timeout(pid_t pid);
+pid_t timer_wait_child(pid_t pid, int *childExitMethod, struct rusage *usage);
+
+long parse_duration(const char *text);
+int parse_signal(const char *text);
+
+#endif
@@ -0,0 +1,204 @@
+/*******************************************************************************
+ * File: journal_top.c
+ * Description: Summarizes smallsh execution journals (see journal.h). Prints
+ * 				the N slowest commands, or with -g the N commands with the most
+ * 				total time, grouping runs with the same args by their hash.
+ * 				Reads only the fields it needs and skips lines it cannot use,
+ * 				so a journal cut off mid-record still summarizes.
+ * Usage: journal_top [-n N] [-g] FILE...
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+// Constants
+#define DEFAULT_TOP 10
+
+// One record, or with -g all the records for one set of args
+struct Entry
+{
+	char hash[17];
+	double ms; // Elapsed time, or the total with -g
+	double maxMs;
+	long count;
+	char status[24];
+	char *cmd;
+};
+
+// Globals
+static struct Entry *ENTRIES = NULL;
+static size_t NUM_ENTRIES = 0;
+static size_t CAP_ENTRIES = 0;
+
+
+/*******************************************************************************
+ * Function: find_field(const char *line, const char *name)
+ * Description: Returns a pointer to the value of the named field in a journal
+ * 				line, or NULL if it is not there.
+*******************************************************************************/
+static const char *find_field(const char *line, const char *name)
+{
+	char key[32];
+	snprintf(key, sizeof(key), "\"%s\":", name);
+	const char *found = strstr(line, key);
+	return (found != NULL) ? found + strlen(key) : NULL;
+}
+
+
+/*******************************************************************************
+ * Function: read_string(const char *value)
+ * Description: Takes a pointer to a JSON string value (at its opening quote).
+ * 				Returns a malloc'd copy with \" and \\ unescaped, or NULL if it
+ * 				is not a complete string.
+*******************************************************************************/
+static char *read_string(const char *value)
+{
+	if (value == NULL || *value != '"')
+		return NULL;
+	char *text = malloc(strlen(value));
+	char *out = text;
+	for (value++; *value != '"'; value++)
+	{
+		if (*value == '\0' || *value == '\n')
+		{
+			free(text);
+			return NULL;
+		}
+		if (*value == '\\' && (value[1] == '"' || value[1] == '\\'))
+			value++;
+		*out++ = *value;
+	}
+	*out = '\0';
+	return text;
+}
+
+
+/*******************************************************************************
+ * Function: add_record(const char *line, bool group)
+ * Description: Adds one journal line, or adds it to its group with -g.
+*******************************************************************************/
+static void add_record(const char *line, bool group)
+{
+	const char *ms = find_field(line, "ms");
+	char *hash = read_string(find_field(line, "hash"));
+	char *cmd = read_string(find_field(line, "cmd"));
+	if (ms == NULL || hash == NULL || cmd == NULL || strlen(hash) != 16)
+	{
+		free(hash);
+		free(cmd);
+		return;
+	}
+	double elapsed = atof(ms);
+
+	if (group)
+	{
+		for (size_t i = 0; i < NUM_ENTRIES; i++)
+		{
+			if (strcmp(ENTRIES[i].hash, hash) == 0)
+			{
+				ENTRIES[i].ms += elapsed;
+				if (elapsed > ENTRIES[i].maxMs)
+					ENTRIES[i].maxMs = elapsed;
+				ENTRIES[i].count++;
+				free(hash);
+				free(cmd);
+				return;
+			}
+		}
+	}
+
+	if (NUM_ENTRIES == CAP_ENTRIES)
+	{
+		CAP_ENTRIES = (CAP_ENTRIES == 0) ? 256 : CAP_ENTRIES * 2;
+		ENTRIES = realloc(ENTRIES, CAP_ENTRIES * sizeof(struct Entry));
+	}
+	struct Entry *entry = &ENTRIES[NUM_ENTRIES++];
+	snprintf(entry->hash, sizeof(entry->hash), "%s", hash);
+	entry->ms = entry->maxMs = elapsed;
+	entry->count = 1;
+	entry->cmd = cmd;
+
+	const char *code;
+	if ((code = find_field(line, "exit")) != NULL)
+		snprintf(entry->status, sizeof(entry->status), "exit %d", atoi(code));
+	else if ((code = find_field(line, "signal")) != NULL)
+		snprintf(entry->status, sizeof(entry->status), "signal %d", atoi(code));
+	else
+		snprintf(entry->status, sizeof(entry->status), "?");
+	free(hash);
+}
+
+
+/*******************************************************************************
+ * Function: compare_entries(const void *a, const void *b)
+ * Description: qsort() comparison that puts the most time first.
+*******************************************************************************/
+static int compare_entries(const void *a, const void *b)
+{
+	double left = ((const struct Entry *)a)->ms;
+	double right = ((const struct Entry *)b)->ms;
+	return (left < right) - (left > right);
+}
+
+
+/*******************************************************************************
+ * Function: main(int argc, char *argv[])
+ * Description: Reads the journals named on the command line and prints the
+ * 				top entries.
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+	int top = DEFAULT_TOP;
+	bool group = false;
+	int option;
+	while ((option = getopt(argc, argv, "n:g")) != -1)
+	{
+		if (option == 'n')
+			top = atoi(optarg);
+		else if (option == 'g')
+			group = true;
+		else
+			optind = argc + 1;
+	}
+	if (optind >= argc || top <= 0)
+	{
+		fprintf(stderr, "usage: %s [-n N] [-g] FILE...\n", argv[0]);
+		return 2;
+	}
+
+	char *line = NULL;
+	size_t bufferSize = 0;
+	for (int i = optind; i < argc; i++)
+	{
+		FILE *file = fopen(argv[i], "r");
+		if (file == NULL)
+		{
+			perror(argv[i]);
+			return 1;
+		}
+		while (getline(&line, &bufferSize, file) != -1)
+			add_record(line, group);
+		fclose(file);
+	}
+	free(line);
+
+	qsort(ENTRIES, NUM_ENTRIES, sizeof(struct Entry), compare_entries);
+	if (group)
+		printf("%10s  %6s  %10s  %10s  %s\n", "TOTAL MS", "RUNS", "MEAN MS", "MAX MS", "COMMAND");
+	else
+		printf("%10s  %-10s  %s\n", "MS", "STATUS", "COMMAND");
+
+	for (size_t i = 0; i < NUM_ENTRIES && i < (size_t)top; i++)
+	{
+		struct Entry *entry = &ENTRIES[i];
+		if (group)
+			printf("%10.1f  %6ld  %10.1f  %10.1f  %s\n", entry->ms, entry->count,
+				entry->ms / entry->count, entry->maxMs, entry->cmd);
+		else
+			printf("%10.1f  %-10s  %s\n", entry->ms, entry->status, entry->cmd);
+	}
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*******************************************************************************
+ * File: smallsh_status.c
+ * Description: Reads a smallsh status page (see statuspage.h) and prints the
+ * 				shell's running jobs and last foreground status. Takes the
+ * 				shell's pid, for /dev/shm/smallsh.<pid>, or a path. Only maps
+ * 				the file; the shell is never asked for anything.
+ * Usage: smallsh_status PID|PATH
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../statuspage.h"
+
+// Constants
+#define MAX_TRIES 1000
+
+
+/*******************************************************************************
+ * Function: snapshot(const struct StatusPage *page, struct StatusPage *copy)
+ * Description: Copies the page under its sequence lock. Returns false if the
+ * 				shell kept changing it for MAX_TRIES attempts.
+*******************************************************************************/
+static bool snapshot(const struct StatusPage *page, struct StatusPage *copy)
+{
+	for (int tries = 0; tries < MAX_TRIES; tries++)
+	{
+		uint64_t before = __atomic_load_n(&page->sequence, __ATOMIC_ACQUIRE);
+		if (before % 2 == 1)
+		{
+			sched_yield();
+			continue;
+		}
+
+		memcpy(copy, page, sizeof(struct StatusPage));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&page->sequence, __ATOMIC_RELAXED) == before)
+			return true;
+	}
+	return false;
+}
+
+
+/*******************************************************************************
+ * Function: main(int argc, char *argv[])
+ * Description: Maps the page named on the command line and prints it.
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+	if (argc != 2)
+	{
+		fprintf(stderr, "usage: %s PID|PATH\n", argv[0]);
+		return 2;
+	}
+
+	char path[4096];
+	if (strspn(argv[1], "0123456789") == strlen(argv[1]))
+		snprintf(path, sizeof(path), "/dev/shm/smallsh.%s", argv[1]);
+	else
+		snprintf(path, sizeof(path), "%s", argv[1]);
+
+	struct stat info;
+	int fd = open(path, O_RDONLY);
+	if (fd == -1 || fstat(fd, &info) == -1 || info.st_size < (off_t)sizeof(struct StatusPage))
+	{
+		fprintf(stderr, "%s: not a status page\n", path);
+		return 1;
+	}
+	const struct StatusPage *page = mmap(NULL, sizeof(struct StatusPage), PROT_READ,
+		MAP_SHARED, fd, 0);
+	close(fd);
+	if (page == MAP_FAILED)
+	{
+		perror(path);
+		return 1;
+	}
+
+	struct StatusPage copy;
+	if (!snapshot(page, &copy))
+	{
+		fprintf(stderr, "%s: page kept changing\n", path);
+		return 1;
+	}
+	if (copy.magic != STATUS_MAGIC || copy.version != STATUS_VERSION ||
+		copy.size != sizeof(struct StatusPage))
+	{
+		fprintf(stderr, "%s: unsupported status page version %u\n", path, copy.version);
+		return 1;
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	int64_t nowNs = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+	printf("smallsh %d, %u jobs", copy.shellPid, copy.numJobs);
+	if (copy.dropped > 0)
+		printf(" (%u not listed)", copy.dropped);
+	printf(", updated %.1fs ago\n", (nowNs - copy.updatedNs) / 1e9);
+
+	printf("last: %s", copy.lastTimedOut ? "timed out, " : "");
+	if (copy.lastExitStatus != -100)
+		printf("exit value %d\n", copy.lastExitStatus);
+	else
+		printf("terminated by signal %d\n", copy.lastTermSignal);
+
+	if (copy.numJobs > 0)
+		printf("%7s  %-10s  %9s  %s\n", "PID", "STATE", "RUNNING", "COMMAND");
+	for (int i = 0; i < STATUS_MAX_JOBS; i++)
+	{
+		const struct StatusJob *job = &copy.jobs[i];
+		if (job->pid == 0)
+			continue;
+		printf("%7d  %-10s  %8.1fs  %s\n", job->pid,
+			job->state == STATUS_BACKGROUND ? "background" : "foreground",
+			(nowNs - job->startNs) / 1e9, job->command);
+	}
+	return 0;
+}
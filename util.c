@@ -0,0 +1,43 @@
+/*******************************************************************************
+ * File: util.c
+ * Description: Implements the helpers declared in util.h.
+*******************************************************************************/
+
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include "util.h"
+
+
+/*******************************************************************************
+ * Function: write_all(int fd, const char *data, size_t len)
+ * Description: Writes all of data to fd, retrying short or interrupted
+ * 				writes. Returns false if it could not.
+*******************************************************************************/
+bool write_all(int fd, const char *data, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t written = write(fd, data, len);
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data += written;
+		len -= written;
+	}
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: now_ms()
+ * Description: Returns a monotonic timestamp in milliseconds.
+*******************************************************************************/
+long now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
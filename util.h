@@ -0,0 +1,15 @@
+/*******************************************************************************
+ * File: util.h
+ * Description: Small helpers shared by the shell's modules: writing a whole
+ * 				buffer to a descriptor and reading the monotonic clock.
+*******************************************************************************/
+#ifndef UTIL_INCLUDED
+#define UTIL_INCLUDED 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool write_all(int fd, const char *data, size_t len);
+long now_ms(void);
+
+#endif
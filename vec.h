@@ -0,0 +1,150 @@
+/*******************************************************************************
+ * File: vec.h
+ * Description: Typed growable arrays, generated per element type by macro.
+ * 				VEC_DECLARE(Type, prefix, T) declares struct Type holding
+ * 				items, size and cap, and static functions prefix_init,
+ * 				prefix_free, prefix_reserve, prefix_push, prefix_pop,
+ * 				prefix_remove_at, prefix_swap_remove and prefix_clear.
+ * 				SMALL_VEC_DECLARE(Type, prefix, T, N) does the same for a vector
+ * 				that keeps up to N items inside the struct and only allocates
+ * 				past that, for short lists such as a command's args.
+ *
+ * 				Capacity doubles as items are added and halves once a removal
+ * 				leaves the vector a quarter full; a small vector moves back
+ * 				into its own buffer when the items fit again. Indexes are not
+ * 				checked. items may move whenever the vector grows or shrinks,
+ * 				and a small vector points into itself, so it must not be
+ * 				copied by value once initialized.
+*******************************************************************************/
+#ifndef VEC_INCLUDED
+#define VEC_INCLUDED 1
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+// Constants
+#define VEC_MIN_CAP 4 // First allocation of a vector without its own buffer
+
+// The functions shared by both kinds; LOCAL is the vector's own buffer (NULL
+// for none) and LOCAL_CAP its size
+#define VEC_FUNCTIONS_(Type, prefix, T, LOCAL, LOCAL_CAP) \
+static inline void prefix##_init(Type *v) \
+{ \
+	v->items = LOCAL; \
+	v->size = 0; \
+	v->cap = LOCAL_CAP; \
+} \
+\
+static inline void prefix##_free(Type *v) \
+{ \
+	if (v->items != LOCAL) \
+		free(v->items); \
+	prefix##_init(v); \
+} \
+\
+/* Moves the items into an allocation of cap, or back into LOCAL if they fit */ \
+static inline void prefix##_resize_(Type *v, int cap) \
+{ \
+	T *items; \
+	if ((LOCAL_CAP) > 0 && cap <= (LOCAL_CAP)) \
+	{ \
+		items = LOCAL; \
+		cap = LOCAL_CAP; \
+	} \
+	else if (v->items == LOCAL) \
+	{ \
+		items = malloc(cap * sizeof(T)); \
+	} \
+	else \
+	{ \
+		v->items = realloc(v->items, cap * sizeof(T)); \
+		v->cap = cap; \
+		return; \
+	} \
+	if (items == v->items) \
+		return; \
+	if (v->size > 0 && v->items != NULL) \
+		memcpy(items, v->items, v->size * sizeof(T)); \
+	if (v->items != LOCAL) \
+		free(v->items); \
+	v->items = items; \
+	v->cap = cap; \
+} \
+\
+static inline void prefix##_reserve(Type *v, int cap) \
+{ \
+	if (cap <= v->cap) \
+		return; \
+	int grown = (v->cap < VEC_MIN_CAP) ? VEC_MIN_CAP : v->cap * 2; \
+	prefix##_resize_(v, (grown > cap) ? grown : cap); \
+} \
+\
+/* Halves the allocation once it is only a quarter used */ \
+static inline void prefix##_shrink_(Type *v) \
+{ \
+	if (v->items != LOCAL && v->cap > VEC_MIN_CAP && v->size <= v->cap / 4) \
+		prefix##_resize_(v, v->cap / 2); \
+} \
+\
+static inline void prefix##_push(Type *v, T value) \
+{ \
+	if (v->size == v->cap) \
+		prefix##_reserve(v, v->size + 1); \
+	v->items[v->size++] = value; \
+} \
+\
+static inline T prefix##_pop(Type *v) \
+{ \
+	T value = v->items[--v->size]; \
+	prefix##_shrink_(v); \
+	return value; \
+} \
+\
+/* Removes an item, keeping the others in order */ \
+static inline void prefix##_remove_at(Type *v, int pos) \
+{ \
+	memmove(&v->items[pos], &v->items[pos+1], (v->size - pos - 1) * sizeof(T)); \
+	v->size--; \
+	prefix##_shrink_(v); \
+} \
+\
+/* Removes an item in O(1) by moving the last one into its place */ \
+static inline void prefix##_swap_remove(Type *v, int pos) \
+{ \
+	v->items[pos] = v->items[--v->size]; \
+	prefix##_shrink_(v); \
+} \
+\
+/* Empties the vector but keeps its allocation for reuse */ \
+static inline void prefix##_clear(Type *v) \
+{ \
+	v->size = 0; \
+}
+
+// A vector that always allocates
+#define VEC_DECLARE(Type, prefix, T) \
+typedef struct Type \
+{ \
+	T *items; \
+	int size; \
+	int cap; \
+} Type; \
+VEC_FUNCTIONS_(Type, prefix, T, ((T *)NULL), 0)
+
+// A vector that holds up to N items without allocating
+#define SMALL_VEC_DECLARE(Type, prefix, T, N) \
+typedef struct Type \
+{ \
+	T *items; \
+	int size; \
+	int cap; \
+	T local[N]; \
+} Type; \
+VEC_FUNCTIONS_(Type, prefix, T, v->local, N)
+
+// The shell's instances
+VEC_DECLARE(PidVec, pid_vec, pid_t)
+SMALL_VEC_DECLARE(ArgVec, arg_vec, char *, 16)
+
+#endif
@@ -0,0 +1,346 @@
+/*******************************************************************************
+ * File: watch.c
+ * Description: Implements the watch builtin. A directory is watched for
+ * 				changes to any entry; a file is watched through its directory
+ * 				with its name as a filter, so editors that save by writing a
+ * 				new file and renaming it over the old one are still seen. The
+ * 				loop sleeps in poll() on the inotify descriptor, a pidfd for
+ * 				the running command and the job deadline timer, so nothing is
+ * 				polled while waiting and a change starts a rerun as soon as
+ * 				the debounce delay has passed. Commands are started by the
+ * 				shell's own spawn function, so they get the same redirection,
+ * 				environment and prefixes as any foreground command.
+*******************************************************************************/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <libgen.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include "output.h"
+#include "timers.h"
+#include "statuspage.h"
+#include "journal.h"
+#include "cgroup.h"
+#include "watch.h"
+#include "util.h"
+
+// Constants
+#define DEBOUNCE_MS 100
+#define POLL_MS 10 // How often a command without a pidfd is checked
+#define STOP_GRACE_MS 2000 // How long a stopped run gets before SIGKILL
+#define MAX_WATCHES 64
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+	IN_MOVED_TO | IN_ATTRIB)
+
+// A watched directory, and the file in it if only one file matters
+struct Watch
+{
+	int wd;
+	char *name; // NULL to match every entry
+};
+
+// Globals
+static volatile sig_atomic_t INTERRUPTED = 0;
+
+
+/*******************************************************************************
+ * Function: catch_SIGINT(int signo)
+ * Description: Signal handler for CTRL-C while watching. Sets INTERRUPTED so
+ * 				the loop stops.
+*******************************************************************************/
+static void catch_SIGINT(int signo)
+{
+	INTERRUPTED = 1;
+}
+
+
+/*******************************************************************************
+ * Function: add_watch(int fd, const char *path, struct Watch *watch)
+ * Description: Watches path: a directory directly, anything else (including a
+ * 				file that does not exist yet) through its directory. Returns
+ * 				false after displaying a message if it cannot be watched.
+*******************************************************************************/
+static bool add_watch(int fd, const char *path, struct Watch *watch)
+{
+	struct stat info;
+	char *copy = strdup(path);
+
+	if (stat(path, &info) == 0 && S_ISDIR(info.st_mode))
+	{
+		watch->wd = inotify_add_watch(fd, path, WATCH_EVENTS);
+		watch->name = NULL;
+	}
+	else
+	{
+		char *dirCopy = strdup(path);
+		watch->wd = inotify_add_watch(fd, dirname(dirCopy), WATCH_EVENTS);
+		watch->name = strdup(basename(copy));
+		free(dirCopy);
+	}
+	free(copy);
+
+	if (watch->wd == -1)
+	{
+		out_printf("watch: cannot watch %s: %s\n", path, strerror(errno));
+		free(watch->name);
+		return false;
+	}
+	return true;
+}
+
+
+/*******************************************************************************
+ * Function: read_changes(int fd, struct Watch watches[], int numWatches)
+ * Description: Reads every queued inotify event. Returns true if any of them
+ * 				is for a watched path.
+*******************************************************************************/
+static bool read_changes(int fd, struct Watch watches[], int numWatches)
+{
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	bool changed = false;
+	ssize_t len;
+
+	while ((len = read(fd, events, sizeof(events))) > 0)
+	{
+		char *pos = events;
+		while (pos < events + len)
+		{
+			struct inotify_event *event = (struct inotify_event *)pos;
+			for (int i = 0; i < numWatches && !changed; i++)
+			{
+				changed = watches[i].wd == event->wd && (watches[i].name == NULL ||
+					(event->len > 0 && strcmp(watches[i].name, event->name) == 0));
+			}
+			pos += sizeof(struct inotify_event) + event->len;
+		}
+	}
+	return changed;
+}
+
+
+/*******************************************************************************
+ * Function: finish_run(pid_t pid, int childExitMethod, const struct rusage *usage, bool report)
+ * Description: Clears the shell's records of a reaped run and journals it. If report is true
+ * 				it is reported when it was signaled or timed out, as for a
+ * 				foreground command.
+*******************************************************************************/
+static void finish_run(pid_t pid, int childExitMethod, const struct rusage *usage,
+	bool report)
+{
+	timer_cancel(pid);
+	bool timedOut = timer_take_timeout(pid);
+	status_page_remove(pid);
+	cgroup_reaped(pid);
+	journal_end(pid, childExitMethod, usage);
+
+	if (report && (WIFSIGNALED(childExitMethod) || timedOut))
+	{
+		out_printf("watch: %s", timedOut ? "timed out, " : "");
+		if (WIFEXITED(childExitMethod))
+			out_printf("exit value %d\n", WEXITSTATUS(childExitMethod));
+		else
+			out_printf("terminated by signal %d\n", WTERMSIG(childExitMethod));
+	}
+	out_flush();
+}
+
+
+/*******************************************************************************
+ * Function: stop_run(pid_t pid, int pidfd, int signo, bool report)
+ * Description: Sends signo to a run and waits for it to end, reporting how it
+ * 				ended if report is true. A run still going after STOP_GRACE_MS,
+ * 				or when CTRL-C interrupts the wait, is sent SIGKILL.
+*******************************************************************************/
+static void stop_run(pid_t pid, int pidfd, int signo, bool report)
+{
+	int childExitMethod;
+	struct rusage usage;
+	kill(pid, signo);
+
+	// Without a pidfd the run is checked every POLL_MS, leaving it unreaped
+	long deadline = now_ms() + STOP_GRACE_MS;
+	bool gone = false;
+	while (!gone)
+	{
+		long remaining = deadline - now_ms();
+		if (remaining <= 0)
+			break;
+		struct pollfd exited = {pidfd, POLLIN, 0};
+		int ready = poll(&exited, 1, (pidfd == -1 && remaining > POLL_MS) ? POLL_MS : remaining);
+		if (ready == -1)
+			break;
+		gone = ready > 0;
+		if (pidfd == -1)
+		{
+			siginfo_t info = {0};
+			gone = waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 &&
+				info.si_pid == pid;
+		}
+	}
+	if (!gone)
+		kill(pid, SIGKILL);
+
+	while (wait4(pid, &childExitMethod, 0, &usage) == -1 && errno == EINTR);
+	finish_run(pid, childExitMethod, &usage, report);
+}
+
+
+/*******************************************************************************
+ * Function: start_run(pid_t (*spawn)(char *command[]), char *command[], int *pidfd)
+ * Description: Starts the command and opens a pidfd for it (-1 if that is not
+ * 				possible). Returns the pid, or -1 if it was not started.
+*******************************************************************************/
+static pid_t start_run(pid_t (*spawn)(char *command[]), char *command[], int *pidfd)
+{
+	pid_t pid = spawn(command);
+	*pidfd = -1;
+#ifdef SYS_pidfd_open
+	if (pid > 0)
+		*pidfd = syscall(SYS_pidfd_open, pid, 0);
+#endif
+	return pid;
+}
+
+
+/*******************************************************************************
+ * Function: watch_run(char *arguments[], pid_t (*spawn)(char *command[]))
+ * Description: Takes in the watch builtin's args and the function that starts
+ * 				a foreground command and returns its pid. Runs the command now
+ * 				and after each change to the paths until CTRL-C.
+*******************************************************************************/
+void watch_run(char *arguments[], pid_t (*spawn)(char *command[]))
+{
+	int debounceMs = DEBOUNCE_MS;
+	bool cancel = false;
+
+	int pos = 1;
+	while (arguments[pos] != NULL && arguments[pos][0] == '-' &&
+		strcmp(arguments[pos], "--") != 0)
+	{
+		if (strcmp(arguments[pos], "-c") == 0)
+			cancel = true;
+		else if (strcmp(arguments[pos], "-d") == 0 && arguments[pos+1] != NULL)
+			debounceMs = atoi(arguments[++pos]);
+		else
+			break;
+		pos++;
+	}
+
+	// Paths up to --, then the command
+	int firstPath = pos;
+	while (arguments[pos] != NULL && strcmp(arguments[pos], "--") != 0)
+		pos++;
+	int numPaths = pos - firstPath;
+	char **command = (arguments[pos] != NULL) ? &arguments[pos+1] : NULL;
+
+	if (numPaths == 0 || numPaths > MAX_WATCHES || command == NULL ||
+		command[0] == NULL || debounceMs < 0)
+	{
+		out_printf("usage: watch [-d MS] [-c] PATH... -- command\n");
+		return;
+	}
+
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd == -1)
+	{
+		out_printf("watch: %s\n", strerror(errno));
+		return;
+	}
+	struct Watch watches[MAX_WATCHES];
+	int numWatches = 0;
+	for (int i = 0; i < numPaths; i++)
+	{
+		if (add_watch(fd, arguments[firstPath + i], &watches[numWatches]))
+			numWatches++;
+	}
+
+	// CTRL-C stops watching; no SA_RESTART so it wakes poll()
+	struct sigaction watchAction = {0}, oldAction;
+	watchAction.sa_handler = catch_SIGINT;
+	sigfillset(&watchAction.sa_mask);
+	INTERRUPTED = 0;
+	sigaction(SIGINT, &watchAction, &oldAction);
+
+	int pidfd;
+	pid_t pid = (numWatches == numPaths) ? start_run(spawn, command, &pidfd) : -1;
+	bool pending = false; // A change is waiting for a rerun
+	long rerunAt = 0; // When the debounce delay ends
+
+	while (!INTERRUPTED && numWatches == numPaths)
+	{
+		struct pollfd fds[3] = {
+			{fd, POLLIN, 0},
+			{timer_fd(), POLLIN, 0},
+			{(pid > 0) ? pidfd : -1, POLLIN, 0}
+		};
+
+		// Sleep until something happens unless a rerun is due
+		int timeout = -1;
+		if (pending && (pid <= 0 || cancel))
+			timeout = (rerunAt > now_ms()) ? rerunAt - now_ms() : 0;
+		if (pid > 0 && pidfd == -1 && (timeout == -1 || timeout > POLL_MS))
+			timeout = POLL_MS;
+
+		if (poll(fds, 3, timeout) == -1 && errno != EINTR)
+			break;
+
+		if (fds[1].revents & POLLIN)
+			timer_expire();
+
+		if ((fds[0].revents & POLLIN) && read_changes(fd, watches, numWatches))
+		{
+			pending = true;
+			rerunAt = now_ms() + debounceMs;
+		}
+
+		// The run ended on its own
+		int childExitMethod;
+		struct rusage usage;
+		if (pid > 0 && wait4(pid, &childExitMethod, WNOHANG, &usage) == pid)
+		{
+			finish_run(pid, childExitMethod, &usage, true);
+			if (pidfd != -1)
+				close(pidfd);
+			pid = -1;
+		}
+
+		if (pending && now_ms() >= rerunAt && (pid <= 0 || cancel) && !INTERRUPTED)
+		{
+			// A run cancelled for a change is not reported
+			if (pid > 0)
+			{
+				stop_run(pid, pidfd, SIGTERM, false);
+				if (pidfd != -1)
+					close(pidfd);
+			}
+			pending = false;
+			pid = start_run(spawn, command, &pidfd);
+		}
+	}
+
+	// The terminal already sent CTRL-C to the run; make sure it ends
+	if (pid > 0)
+	{
+		stop_run(pid, pidfd, SIGINT, true);
+		if (pidfd != -1)
+			close(pidfd);
+	}
+
+	sigaction(SIGINT, &oldAction, NULL);
+	for (int i = 0; i < numWatches; i++)
+		free(watches[i].name);
+	close(fd);
+}
@@ -0,0 +1,19 @@
+/*******************************************************************************
+ * File: watch.h
+ * Description: The watch builtin:
+ * 					watch [-d MS] [-c] PATH... -- command...
+ * 				runs command, then runs it again each time one of the paths
+ * 				changes, until CTRL-C. Changes are noticed with inotify and
+ * 				bursts of them are combined into one rerun after MS
+ * 				milliseconds (100 by default) without another change. With -c
+ * 				a run still going when a change comes in is stopped first;
+ * 				otherwise the rerun waits for it to finish.
+*******************************************************************************/
+#ifndef WATCH_INCLUDED
+#define WATCH_INCLUDED 1
+
+#include <sys/types.h>
+
+void watch_run(char *arguments[], pid_t (*spawn)(char *command[]));
+
+#endif